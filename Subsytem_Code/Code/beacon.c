@@ -17,10 +17,7 @@ void beacon_transmit(char text[])
 	
 	for(;message_counter<8;message_counter++)
 	{
-		for(unsigned i=0x00; i<128; i++)
-		{
-			dir_FIFO_write(i, morse_message[i+message_counter*128]);
-		}
+		dir_FIFO_write_burst(0, (uint8_t*)&morse_message[message_counter*128], 128);
 		reg_write2F(0xD3, 0x00);
 		reg_write2F(0xD5, 0x7F);
 		cmd_str(STX);
@@ -51,21 +51,74 @@
 	*					to different values depending on the value of SELF_ID which determines whether
 	*					this SSM is EPS or COMS or PAYL.
 	*
+	*	10/16/2026		Reception is now interrupt driven. CAN_INT_vect copies completed frames out of
+	*					MOb0-3 and MOb5 into can_rx_ring[] and re-arms the MOb right away, so frames which
+	*					arrive while we are stuck in a delay_ms() are no longer overwritten. can_check_general()
+	*					now drains the ring in batches and can_check_housekeep() has been folded into it.
+	*					can_rx_overruns and can_rx_high_water keep track of how close we are to losing frames.
+	*
+	*					Transmission no longer blocks. can_send_message() places the frame in can_tx_queue[]
+	*					(sorted by CAN ID) and CAN_INT_vect loads the next frame into a transmit MOb each time
+	*					one completes. The ATmega32M1 only has MOb0-5, so CAN_TX_MOB_MASK is just MOb4 for now;
+	*					any MOb which is freed up later can simply be added to the mask.
+	*
+	*					decode_command() is now a lookup into command_table[] (in flash) instead of a
+	*					switch. Commands which only set a variable are run immediately, everything else is
+	*					placed in cmd_queue[] which run_commands() empties through run_next_command().
+	*					This replaces the send_now, send_hk, ... flags and their copies of the message.
+	*
+	*					CAN_INT_vect now passes every MOb status to can_health_mob() (can_health.c), and
+	*					can_send_message() drops frames right away while the controller is bus-off.
+	*
+	*					Every frame is now timestamped with the CAN timer (CANSTM extended to 32 bits).
+	*					can_rx_time holds the timestamp of the frame being decoded, can_tx_time the one
+	*					of the last frame sent. Commands remember their timestamp in cmd_queue_stamp[] so
+	*					that the time from reception to the end of the handler can be recorded.
+	*
+	*					Frames with MT_TP set in byte 6 belong to the segmented PUS transfer (pus_tp.c).
+	*
+	*					Removed set_up_msg() and clean_up_msg() along with the data0..data5 buffers and
+	*					receive_arr. CAN_INT_vect copies CANMSG straight into the ring and re-arms a receive
+	*					MOb with Can_rx_rearm() (clear status + enable reception) since the ID and mask of
+	*					our receive MObs never change.
+	*
+	*					can_tx_queue[] is now one FIFO per priority class (urgent, command, bulk) instead of
+	*					a single list sorted by ID. can_send_message() derives the priority from the frame
+	*					with can_message_prio(); can_send_message_prio() lets the caller choose it.
+	*
+	*					Reception uses acceptance filters (can_filters[]) instead of one MOb per ID.
+	*					SUBn_ID0 - SUBn_ID5 now take MOb1 and MOb2, which frees MOb0 to send urgent
+	*					frames (CAN_TX_URGENT_MOB) and leaves MOb3 and MOb5 unused.
+	*
+	*					TIME_SYNC and TIME_FUP are passed to time_sync.c, which uses can_rx_time.
+	*
+	*					CAN_RATE_SWITCH and CAN_RATE_TEST are passed to can_rate.c.
+	*
+	*	10/17/2026		The priority class is only written into CAN ID bits 10-8 if CAN_ID_CLASS_BITS is set,
+	*					the IDs on the bus are unchanged by default.
+	*
+	*	10/17/2026		can_init_mobs() no longer empties the receive ring, a bus-off recovery or bit rate
+	*					switch threw away the frames waiting to be decoded. It is emptied once at boot.
+	*
+	*	10/17/2026		decode_command() finds a pending CMD_COALESCE command by looking through cmd_queue[]
+	*					instead of keeping cmd_slot[NUM_SMALL_TYPES]. Latency and queueing delay statistics
+	*					are only kept with CAN_LATENCY_STATS. Both to give COMS its RAM back.
+	*
 */
 
 /************************************************************************/
 /*	CHECK FOR A GENERAL CAN MESSAGE                                     */
 /*																		*/
-/*	This function checks to see if a general can message has been		*/
-/*	received in MOB0. If the message matches to one currently in		*/
-/*	our message library, then we set a flag which will indicate that an	*/
-/*	action needs to be performed some time in the current program loop.	*/
-/*																		*/
-/*	These flags include send_now for commands and send_data for data.	*/
+/*	This function drains the CAN receive ring buffer which is filled by	*/
+/*	the CAN interrupt. Up to CAN_RX_BATCH frames are decoded per call.	*/
+/*	Command messages are passed to decode_command() which either acts	*/
+/*	on them right away or queues them for run_commands().				*/
 /************************************************************************/
 
 #include "can_api.h"
+#include <avr/pgmspace.h>
 
+static void can_tx_start(uint8_t mob);
 #if(SELF_ID == 0)
 static void start_tm_packet(void);
 #endif
@@ -73,442 +126,635 @@ static void start_tm_packet(void);
 void can_check_general(void)
 {
 	uint8_t i = 0;
-	uint8_t mb = 0;
+	uint8_t batch = CAN_RX_BATCH;
+	uint8_t message_arr[8];			// Local, decoding may call us again.
+	volatile uint8_t* frame;
+#if (CAN_LATENCY_STATS)
+	uint32_t age;
+#endif
 	
-	for(mb = 0; mb < 4; mb ++)
+	while(batch-- && (can_rx_tail != can_rx_head))
 	{
-		set_up_msg(mb);		// Sets up the message object.
+		frame = can_rx_ring[can_rx_tail & (CAN_RX_RING_SIZE - 1)];
+		for (i = 0; i < 8; i ++)		// Transfer the message out of the ring.
+		{
+			message_arr[i] = *(frame + i);
+		}
+		can_rx_time = can_rx_stamp[can_rx_tail & (CAN_RX_RING_SIZE - 1)];
+#if (CAN_LATENCY_STATS)
+		age = can_time_us() - can_rx_time;
+		if(age > can_rx_age_max)
+			can_rx_age_max = age;
+		if((age > CAN_RX_LATE_US) && (can_rx_late < 0xFFFF))
+			can_rx_late++;
+#endif
+		can_rx_tail++;					// Release the slot before decoding (decode may call us again).
 		
-		if(can_get_status(&message, mob_number) != CAN_STATUS_NOT_COMPLETED) // wait for a message to come in.
+		if(message_arr[6] & MT_TP)		// Segmented transfer, the rest of byte 6 is not a BIG TYPE.
 		{
-			if(message.status == MOB_RX_COMPLETED)
-			{
-				
-				for (i = 0; i < 8; i ++)		// Transfer the message to the receive array.
-				{
-					receive_arr[i] = *(message.pt_data + i);
-				}
-					switch(receive_arr[6]) // BIG TYPE
-					{
-						case MT_COM :
-							decode_command(&receive_arr[0]); // SMALL TYPE
-							break;
-						case MT_HK :
-							break;
-						case MT_DATA :
-							
-							break;
-						case MT_TC :
-							break;
-						default:
-							break;
-					}
-				for (i = 0; i < 8; i ++)
-				{
-					receive_arr[i] = 0;			// Reset the message array to zero after each message.
-				}
-			}
-			
-			clean_up_msg(mb);					// Clean up the message object.
+#if (SELF_ID == 0) && (PUS_SEGMENTED)
+			tp_receive(&message_arr[0]);
+#endif
+		}
+		else switch(message_arr[6]) // BIG TYPE
+		{
+			case MT_COM :
+				decode_command(&message_arr[0]); // SMALL TYPE
+				break;
+			case MT_HK :
+				break;
+			case MT_DATA :
+				break;
+			case MT_TC :
+				break;
+			default:
+				break;
 		}
 	}
 	
-	can_check_housekeep();
-	
 	return;
 }
 
 /************************************************************************/
-/*	CHECK FOR A HOUSEKEEPING REQUEST		                            */
+/*	CAN INTERRUPT                                                       */
+/*																		*/
+/*	Receive MObs (CAN_RX_MOB_MASK): the completed frame is copied into	*/
+/*	the receive ring buffer and the MOb is immediately re-armed so that	*/
+/*	a burst from the OBC is not lost while the main loop is busy (ex:	*/
+/*	in delay_ms()). If the ring is full, the frame is dropped and		*/
+/*	can_rx_overruns is incremented.										*/
 /*																		*/
-/*	This function checks to see if housekeeping has been requested, if  */
-/*	it has, then we set the flag send_hk to 1.							*/
+/*	Transmit MObs (CAN_TX_MOB_MASK): the MOb is released and the next	*/
+/*	frame in the transmit queue (if any) is loaded into it.				*/
 /************************************************************************/
-void can_check_housekeep(void)
+ISR(CAN_INT_vect)
 {
-	uint8_t i = 0;
-	uint8_t mb = 5;
+	uint8_t i, mob, pending, count, page_saved;
+	volatile uint8_t* frame;
 	
-	set_up_msg(mb);		// Sets up the message object.
-		
-	if(can_get_status(&message, mob_number) != CAN_STATUS_NOT_COMPLETED) // wait for a message to come in.
+	page_saved = CANPAGE;				// The main loop may be in the middle of a MOb access.
+	pending = CANSIT2 & (CAN_RX_MOB_MASK | CAN_TX_MOB_MASK);
+	
+	for (mob = 0; mob < NB_MOB; mob++)
 	{
-		if(message.status == MOB_RX_COMPLETED)
+		if (!(pending & (1 << mob)))
+			continue;
+		Can_set_mob(mob);
+		can_health_mob(mob, CANSTMOB);	// Count the frame and any errors before the status is cleared.
+		if (CAN_TX_MOB_MASK & (1 << mob))
 		{
-			for (i = 0; i < 8; i ++)		// Transfer the message to the receive array.
+			if (CANSTMOB & (1 << TXOK))
 			{
-				receive_arr[i] = *(message.pt_data + i);
+				can_tx_time = can_stamp_us(CANSTM);
+				Can_clear_status_mob();
+				Can_mob_abort();
+				can_tx_busy &= ~(1 << mob);
+				can_tx_start(mob);
 			}
-				
-			switch(receive_arr[6]) // BIG TYPE
-			{
-				case MT_COM :
-					decode_command(&receive_arr[0]); // SMALL TYPE
-				case MT_HK :
-					break;
-				case MT_DATA :
-					break;
-				case MT_TC :
-					break;
-				default:
-				break;
-			}
-			for (i = 0; i < 8; i ++)
+			continue;
+		}
+		if (CANSTMOB & (1 << RXOK))
+		{
+			count = can_rx_head - can_rx_tail;
+			if (count < CAN_RX_RING_SIZE)
 			{
-				receive_arr[i] = 0;			// Reset the message array to zero after each message.
+				frame = can_rx_ring[can_rx_head & (CAN_RX_RING_SIZE - 1)];
+				for (i = 0; i < 8; i++)	// CANMSG auto-increments (AINC = 0 after Can_set_mob()).
+				{
+					frame[i] = CANMSG;
+				}
+				can_rx_stamp[can_rx_head & (CAN_RX_RING_SIZE - 1)] = can_stamp_us(CANSTM);
+				can_rx_head++;
+				count++;
+				if (count > can_rx_high_water)
+					can_rx_high_water = count;
 			}
+			else
+				can_rx_overruns++;
 		}
-			
-		clean_up_msg(mb);					// Clean up the message object.
-	}	
-	return;
+		Can_rx_rearm();					// ID, mask and DLC are left as they were.
+	}
+	
+	CANPAGE = page_saved;
 }
 
-
 /************************************************************************/
-/*		SEND A CAN MESSAGE	                                            */
+/*		CAN MESSAGE PRIORITY                                            */
 /*																		*/
-/*		This function takes in an array which is the message which is	*/
-/*		meant to be sent and then executes the required operations		*/
-/*		to send the can message. In the future, the node ID, mob_number	*/
-/*		and data array being used should be parameters to this function.*/
+/*		Works out the priority of an outgoing message from its			*/
+/*		contents, so that existing calls to can_send_message() do not	*/
+/*		need to be changed. Errors and alerts are the most urgent,		*/
+/*		then command traffic, then housekeeping and data.				*/
 /************************************************************************/
 
-void can_send_message(uint8_t* data_array, uint8_t id)
+uint8_t can_message_prio(uint8_t* data_array, uint8_t id)
 {
-	uint8_t i = 0;
-
-	message.pt_data = &data4[0]; // point message object to first element of data buffer
-	message.ctrl.ide = 0;		 // standard CAN frame type (2.0A)
-	message.id.std = id;  // populate ID field with ID Tag
-	message.cmd = CMD_TX_DATA;   // assign this as a transmitting message object.
-	message.dlc = 8;			 // Max length of a CAN message.
-	mob_number = 4;
+	uint8_t big_type = *(data_array + 6);
+	uint8_t small_type = *(data_array + 5);
 	
-	for (i = 0; i < 8; i ++)
+	if(big_type & MT_TP)			// Segmented transfer: handshakes go with commands, the packet is bulk.
 	{
-		data4[i] = *(data_array + i) ;		// Message to be sent back to the OBC.
+		if(((big_type & TP_TYPE_MASK) == TP_FC) || ((big_type & TP_TYPE_MASK) == TP_ACK))
+			return COMMAND_PRIO;
+		return DATA_PRIO;
 	}
-	while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED); // wait for MOb4 to configure
-	while(can_get_status(&message, mob_number) == CAN_STATUS_NOT_COMPLETED); // wait for a message to send or fail.
+	switch(big_type)
+	{
+		case MT_COM :
+			if((small_type == SSM_ERROR_ASSERT) || (small_type == SSM_ERROR_REPORT)
+				|| (small_type == ALERT_DEPLOY) || (small_type == SEND_EVENT))
+				return URGENT_PRIO;
+			return COMMAND_PRIO;
+		case MT_HK :
+			return HK_REQUEST_PRIO;
+		case MT_DATA :
+			return DATA_PRIO;
+		default:
+			return DEF_PRIO;
+	}
+}
 
-	return;
+// Maps a priority onto one of the transmit queues.
+static uint8_t can_prio_class(uint8_t prio)
+{
+	if(prio >= URGENT_PRIO)
+		return CAN_CLASS_URGENT;
+	if(prio >= COMMAND_PRIO)
+		return CAN_CLASS_COMMAND;
+	return CAN_CLASS_BULK;
 }
 
-void decode_command(uint8_t* command_array)
-{		
-	uint8_t i, command  = *(command_array + 5);
-	//uint8_t req_by = (*(command_array + 7)) >> 4;
-	switch(command)
+/************************************************************************/
+/*		QUEUE A CAN MESSAGE	                                            */
+/*																		*/
+/*		This function copies an 8-byte message into the transmit queue	*/
+/*		of its priority class and returns immediately. Each class is a	*/
+/*		FIFO, and a free transmit MOb is always given the oldest frame	*/
+/*		of the most urgent class which has one, so a long housekeeping	*/
+/*		dump cannot hold up an alert or a command response. With		*/
+/*		CAN_ID_CLASS_BITS the class is also written into bits 10-8 of	*/
+/*		the CAN ID so that urgent frames win arbitration against other	*/
+/*		nodes' bulk traffic. Every receiver (the OBC included) must		*/
+/*		then ignore those bits.											*/
+/*																		*/
+/*		Returns CAN_TX_QUEUED, or CAN_TX_FULL if there was no room (or	*/
+/*		the controller is bus-off).										*/
+/************************************************************************/
+
+uint8_t can_queue_message(uint8_t* data_array, uint8_t id, uint8_t prio)
+{
+	uint8_t i, pos, sreg, mob, class;
+	
+	class = can_prio_class(prio);
+	sreg = SREG;
+	cli();
+	if(can_bus_off || (can_tx_count[class] >= CAN_TX_CLASS_SIZE))
 	{
-		case REQ_RESPONSE :
-			send_now = 1;
-			break;
-		case REQ_DATA :
-			//if(SELF_ID == 0)
-			//{
-				//PIN_toggle(LED3);
-			//}
-			send_data = 1;
-			for (i = 0; i < 8; i ++)
-			{
-				data_req_arr[i] = *(command_array + i);
-			}
-			break;
-		case REQ_HK :
-			send_hk = 1;
-			break;
-		case REQ_READ:
-			read_response = 1;
-			for (i = 0; i < 8; i ++)
-			{
-				read_arr[i] = *(command_array + i);
-			}
-			break;
-		case REQ_WRITE:
-			write_response = 1;
-			for (i = 0; i < 8; i ++)
-			{
-				write_arr[i] = *(command_array + i);
-			}
-			break;
-		case SET_SENSOR_HIGH:
-			set_sens_h = 1;
-			for (i = 0; i < 8; i ++)
-			{
-				sensh_arr[i] = *(command_array + i);
-			}
-			break;
-		case SET_SENSOR_LOW:
-			set_sens_l = 1;
-			for (i = 0; i < 8; i ++)
-			{
-				sensl_arr[i] = *(command_array + i);
-			}
-			break;
-		case SET_VAR:
-			set_varf = 1;
-			for (i = 0; i < 8; i ++)
-			{
-				setv_arr[i] = *(command_array + i);
-			}		
-			break;
-		case SET_TIME:
-			CURRENT_MINUTE = *(command_array);
-			break;
-		case DISABLE_UART:
-			uart_disable = 1;
-			DDRD &= ~(1<<3);	 // PD3 = TXD is output
-		case ENABLE_UART:
-			uart_disable = 0;
-			DDRD |= (1<<3);		// PD3 = TXD is output
-			
-#if (SELF_ID == 0)
-		case SEND_TM:
-			#if (SELF_ID == 0)
-				new_tm_msgf = 1;
-				for (i = 0; i < 8; i ++)
-				{
-					new_tm_msg[i] = *(command_array + i);
-				}			
-			#endif
-			break;
-		case TM_PACKET_READY:
-			//current_tm_fullf = 0;
-			//if((!current_tm_fullf) && (!receiving_tmf))
-			if(!receiving_tmf)
-				start_tm_packet();
-			break;
-		case TC_TRANSACTION_RESP:
-			#if (SELF_ID == 0)
-				tc_transfer_completef = *command_array;
-			#endif
-			break;
-		case OK_START_TC_PACKET:
-			#if (SELF_ID == 0)
-				start_tc_transferf = 1;
-			#endif
-			break;
-		case OBC_IS_ALIVE:
-			TAKEOVER = 0;
-			REQUEST_ALIVE_IN_PROG = 0;
-			REQUEST_TAKEOVER = 0;
-			ISALIVE_COUNTER = 0;
-			FAILED_COUNT = 0;
-			break;
-		case ENTER_COMS_TAKEOVER_COM:
-			if(!SELF_ID && !TAKEOVER)
-				enter_take_overf = 1;
-			break;
-		case EXIT_COMS_TAKEOVER_COM:
-			if(!SELF_ID && TAKEOVER)
-				exit_take_overf = 1;
-			break;
-		case DISABLE_RADIO:
-			DDRD = 0x63;
-			break;
-		case ENABLE_RADIO:
-			DDRD = 0x6F;
-			break;
-#endif
-#if (SELF_ID == 1)
-		case ENTER_LOW_POWER_COM:
-			if((SELF_ID == 1) && !LOW_POWER_MODE)
-				enter_low_powerf = 1;
-			break;
-		case EXIT_LOW_POWER_COM:
-			if((SELF_ID == 1) && LOW_POWER_MODE)
-				exit_low_powerf = 1;
-			break;
+		SREG = sreg;
+		return CAN_TX_FULL;
+	}
+	
+	pos = (can_tx_head[class] + can_tx_count[class]) % CAN_TX_CLASS_SIZE;
+#if (CAN_ID_CLASS_BITS)
+	can_tx_queue[class][pos].id = ((uint16_t)class << 8) | id;
+#else
+	can_tx_queue[class][pos].id = id;
 #endif
-		case PAUSE_OPERATIONS:
-			pause_operationsf = 1;
-			for (i = 0; i < 8; i ++)
-			{
-				pause_msg[i] = *(command_array + i);
-			}
-			break;
-		case RESUME_OPERATIONS:
-			resume_operationsf = 1;
-			for (i = 0; i < 8; i ++)
-			{
-				resume_msg[i] = *(command_array + i);
-			}
-			break;
-		case DEP_ANT_COMMAND:
-			deploy_antennaf = 1;
-			break;
-		case DEP_ANT_OFF:
-			turn_off_deployf = 1;
-			break;
-#if (SELF_ID == 2)
-		case OPEN_VALVES:
-			open_valvesf = 1;
-			break;
-		case COLLECT_PD:
-			collect_pdf = 1;
-			break;
+#if (CAN_LATENCY_STATS)
+	can_tx_queue[class][pos].queued = (uint16_t)(can_time_us() >> CMD_LAT_SHIFT);
 #endif
-		default:
-			return;
+	for (i = 0; i < 8; i ++)
+	{
+		can_tx_queue[class][pos].data[i] = *(data_array + i);
 	}
-	return;
+	can_tx_count[class]++;
+	if(can_tx_count[class] > can_tx_high_water[class])
+		can_tx_high_water[class] = can_tx_count[class];
+	
+	for (mob = 0; mob < NB_MOB; mob++)		// Kick the idle transmit MObs.
+	{
+		if((CAN_TX_MOB_MASK & (1 << mob)) && !(can_tx_busy & (1 << mob)))
+			can_tx_start(mob);
+	}
+	SREG = sreg;
+	return CAN_TX_QUEUED;
+}
+
+/************************************************************************/
+/*		SEND A CAN MESSAGE	                                            */
+/*																		*/
+/*		This function takes in an array which is the message which is	*/
+/*		meant to be sent and places it in the transmit queue. It only	*/
+/*		waits if the queue is full, and then for at most				*/
+/*		CAN_TX_WAIT_TRIES * CAN_TX_WAIT_US before giving up.			*/
+/*		can_send_message() picks the priority with can_message_prio(),	*/
+/*		can_send_message_prio() takes it as a parameter.				*/
+/************************************************************************/
+
+uint8_t can_send_message(uint8_t* data_array, uint8_t id)
+{
+	return can_send_message_prio(data_array, id, can_message_prio(data_array, id));
 }
 
-void set_up_msg(uint8_t mailbox)
+uint8_t can_send_message_prio(uint8_t* data_array, uint8_t id, uint8_t prio)
 {
-	message.ctrl.ide = 0;		 // standard CAN frame type (2.0A)
-	message.cmd = CMD_RX_DATA;   // assign this as a receiving message object.
-	message.dlc = 8;			 // Max length of a CAN message.
-	mob_number = mailbox;
+	uint8_t tries = CAN_TX_WAIT_TRIES;
 	
-	if(mailbox == 0)
+	if(can_bus_off)				// No point in waiting, can_health_poll() will reset the controller.
 	{
-		message.pt_data = &data0[0]; // point message object to first element of data buffer
-		message.id.std = id_array[0];  // populate ID field with ID Tag
-		return;
+		can_tx_dropped++;
+		return CAN_TX_FULL;
 	}
-	if(mailbox == 1)
+	while(can_queue_message(data_array, id, prio) == CAN_TX_FULL)
 	{
-		message.pt_data = &data1[0];
-		message.id.std = id_array[1];
-		return;
+		if(!tries--)
+		{
+			can_tx_dropped++;
+			return CAN_TX_FULL;
+		}
+		delay_us(CAN_TX_WAIT_US);
 	}
-	if(mailbox == 2)
+	return CAN_TX_QUEUED;
+}
+
+/************************************************************************/
+/*		CAN TX PENDING	                                                */
+/*																		*/
+/*		Returns the number of frames which are either queued or still	*/
+/*		being transmitted.												*/
+/************************************************************************/
+
+uint8_t can_tx_pending(void)
+{
+	uint8_t mob, class, pending = 0;
+	
+	for (class = 0; class < CAN_TX_CLASSES; class++)
 	{
-		message.pt_data = &data2[0];
-		message.id.std = id_array[2];
-		return;
+		pending += can_tx_count[class];
 	}
-	if(mailbox == 3)
+	for (mob = 0; mob < NB_MOB; mob++)
 	{
-		message.pt_data = &data3[0];
-		message.id.std = id_array[3];
-		return;
+		if(can_tx_busy & (1 << mob))
+			pending++;
 	}
-	if(mailbox == 5)
+	return pending;
+}
+
+// Returns how many more frames of the given priority can be queued right now.
+uint8_t can_tx_room(uint8_t prio)
+{
+	return CAN_TX_CLASS_SIZE - can_tx_count[can_prio_class(prio)];
+}
+
+/************************************************************************/
+/*		CAN TX START	                                                */
+/*																		*/
+/*		Pops the oldest frame of the most urgent non-empty class into	*/
+/*		the given MOb and enables it for transmission. Urgent frames	*/
+/*		only go out through CAN_TX_URGENT_MOB, the other classes		*/
+/*		through the remaining transmit MOb. Since the lowest MOb is		*/
+/*		sent first, an urgent frame never waits behind a bulk one.		*/
+/*		Also records how long the frame was queued. This is called		*/
+/*		with interrupts disabled (or from CAN_INT_vect).				*/
+/************************************************************************/
+
+static void can_tx_start(uint8_t mob)
+{
+	uint8_t i, page_saved, class;
+	uint16_t id;
+#if (CAN_LATENCY_STATS)
+	uint16_t wait;
+#endif
+	volatile can_frame* frame;
+	
+	if(mob == CAN_TX_URGENT_MOB)		// One MOb per class keeps the frames of a class in order.
 	{
-		message.pt_data = &data5[0];
-		message.id.std = id_array[5];
-		return;
-	}	
+		if(!can_tx_count[CAN_CLASS_URGENT])
+			return;
+		class = CAN_CLASS_URGENT;
+	}
+	else
+	{
+		for (class = CAN_CLASS_COMMAND; class < CAN_TX_CLASSES; class++)	// Most urgent class first.
+		{
+			if(can_tx_count[class])
+				break;
+		}
+		if(class >= CAN_TX_CLASSES)
+			return;
+	}
+	frame = &can_tx_queue[class][can_tx_head[class]];
+	
+	page_saved = CANPAGE;
+	Can_set_mob(mob);
+	Can_clear_mob();
+	id = frame->id;
+	Can_set_std_id(id);
+	for (i = 0; i < 8; i ++)
+	{
+		CANMSG = frame->data[i];
+	}
+	Can_clear_rtr();
+	Can_set_dlc(8);
+	Can_config_tx();
+	can_tx_busy |= (1 << mob);
+	CANPAGE = page_saved;
+	
+#if (CAN_LATENCY_STATS)
+	wait = (uint16_t)(can_time_us() >> CMD_LAT_SHIFT) - frame->queued;
+	if(wait > can_tx_wait_max[class])
+		can_tx_wait_max[class] = wait;
+	can_tx_wait_sum[class] += wait;
+	can_tx_sent[class]++;
+#endif
+	can_tx_head[class] = (can_tx_head[class] + 1) % CAN_TX_CLASS_SIZE;
+	can_tx_count[class]--;
 	return;
 }
 
-void clean_up_msg(uint8_t mailbox)
+/************************************************************************/
+/*	DECODE COMMAND                                                      */
+/*																		*/
+/*	The SMALL-TYPE of a command message indexes command_table[] which	*/
+/*	lives in flash. Commands marked CMD_IMMEDIATE are carried out right	*/
+/*	here, the rest are copied into cmd_queue[] and carried out in order	*/
+/*	of arrival by run_commands(). A CMD_COALESCE command which is		*/
+/*	already waiting is simply updated with the newest message.			*/
+/************************************************************************/
+
+static void set_time(uint8_t* command)
 {
-	if(mailbox == 0)
-	{
-		message.ctrl.ide = 0;		 // standard CAN frame type (2.0A)
-		message.cmd = CMD_RX_DATA;   // assign this as a receiving message object.
-		message.dlc = 8;			 // Max length of a CAN message.
-		mob_number = mailbox;
-		message.pt_data = &data0[0]; // point message object to first element of data buffer
-		message.id.std = id_array[0];  // populate ID field with ID Tag
-		while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED); // wait for MOb to configure
+	CURRENT_MINUTE = *(command);
+	return;
+}
+
+static void disable_uart(uint8_t* command)
+{
+	uart_disable = 1;
+	DDRD &= ~(1<<3);	// PD3 = TXD is input
+	return;
+}
+
+static void enable_uart(uint8_t* command)
+{
+	uart_disable = 0;
+	DDRD |= (1<<3);		// PD3 = TXD is output
+	return;
+}
+
+#if (SELF_ID == 0)
+static void tm_msg_received(uint8_t* command)
+{
+	receive_tm_msg(command);
+	new_tm_msgf = 1;	// Lets start_tm_packet() know that the OBC is still sending.
+	return;
+}
+
+static void tm_packet_ready(uint8_t* command)
+{
+	//current_tm_fullf = 0;
+	//if((!current_tm_fullf) && (!receiving_tmf))
+	if(!receiving_tmf)
+		start_tm_packet();
+	return;
+}
+
+static void tc_transaction_resp(uint8_t* command)
+{
+	tc_transfer_completef = *command;
+	return;
+}
+
+static void ok_start_tc_packet(uint8_t* command)
+{
+	start_tc_transferf = 1;
+	return;
+}
+
+static void obc_is_alive(uint8_t* command)
+{
+	TAKEOVER = 0;
+	REQUEST_ALIVE_IN_PROG = 0;
+	REQUEST_TAKEOVER = 0;
+	ISALIVE_COUNTER = 0;
+	FAILED_COUNT = 0;
+	return;
+}
+
+static void disable_radio(uint8_t* command)
+{
+	DDRD = 0x63;
+	return;
+}
+
+static void enable_radio(uint8_t* command)
+{
+	DDRD = 0x6F;
+	return;
+}
+#endif
+
+static const command_entry command_table[NUM_SMALL_TYPES] PROGMEM =
+{
+	[REQ_RESPONSE]				= {send_response,		CMD_COALESCE},
+	[REQ_DATA]					= {send_sensor_data,	0},
+	[REQ_HK]					= {send_housekeeping,	CMD_COALESCE},
+	[REQ_CAN_HEALTH]			= {send_can_health,		CMD_COALESCE},
+#if (CAN_LATENCY_STATS)
+	[REQ_CMD_LATENCY]			= {send_cmd_latency,	CMD_COALESCE},
+#endif
+	[TIME_SYNC]					= {time_sync_received,	CMD_IMMEDIATE},
+	[TIME_FUP]					= {time_fup_received,	CMD_IMMEDIATE},
+	[CAN_RATE_SWITCH]			= {can_rate_switch,		CMD_IMMEDIATE},
+	[CAN_RATE_TEST]				= {can_rate_test,		CMD_COALESCE},
+#if (HK_PACKED)
+	[HK_ACK]					= {hk_ack_received,		CMD_IMMEDIATE},
+#endif
+	[REQ_READ]					= {send_read_response,	0},
+	[REQ_WRITE]					= {send_write_response,	0},
+	[SET_SENSOR_HIGH]			= {set_sensor_high,		0},
+	[SET_SENSOR_LOW]			= {set_sensor_low,		0},
+	[SET_VAR]					= {set_var,				0},
+	[SET_TIME]					= {set_time,			CMD_IMMEDIATE},
+	[DISABLE_UART]				= {disable_uart,		CMD_IMMEDIATE},
+	[ENABLE_UART]				= {enable_uart,			CMD_IMMEDIATE},
+#if (SELF_ID == 0)
+	[SEND_TM]					= {tm_msg_received,		CMD_IMMEDIATE},
+	[TM_PACKET_READY]			= {tm_packet_ready,		CMD_IMMEDIATE},
+	[TC_TRANSACTION_RESP]		= {tc_transaction_resp,	CMD_IMMEDIATE},
+	[OK_START_TC_PACKET]		= {ok_start_tc_packet,	CMD_IMMEDIATE},
+	[OBC_IS_ALIVE]				= {obc_is_alive,		CMD_IMMEDIATE},
+	//[ENTER_COMS_TAKEOVER_COM]	= {enter_take_over,		CMD_COALESCE},
+	[EXIT_COMS_TAKEOVER_COM]	= {exit_take_over,		CMD_COALESCE},
+	[DISABLE_RADIO]				= {disable_radio,		CMD_IMMEDIATE},
+	[ENABLE_RADIO]				= {enable_radio,		CMD_IMMEDIATE},
+	[REQ_RF_LINK]				= {send_rf_link,		CMD_COALESCE},
+#endif
+#if (SELF_ID == 1)
+	[ENTER_LOW_POWER_COM]		= {enter_low_power,		CMD_COALESCE},
+	[EXIT_LOW_POWER_COM]		= {exit_low_power,		CMD_COALESCE},
+	[DEP_ANT_COMMAND]			= {deploy_antenna,		CMD_COALESCE},
+	[DEP_ANT_OFF]				= {turn_off_deploy,		CMD_COALESCE},
+#endif
+	//[PAUSE_OPERATIONS]		= {pause_operations,	CMD_COALESCE},
+	[RESUME_OPERATIONS]			= {resume_operations,	CMD_COALESCE},
+#if (SELF_ID == 2)
+	[OPEN_VALVES]				= {open_valves,			CMD_COALESCE},
+	[COLLECT_PD]				= {collect_pd,			CMD_COALESCE},
+#endif
+};
+
+void decode_command(uint8_t* command_array)
+{		
+	uint8_t i, n, slot, flags, command = *(command_array + 5);
+#if (CAN_LATENCY_STATS)
+	uint32_t stamp = can_rx_time;		// The handler may decode other frames.
+#endif
+	command_handler handler;
+	
+	if(command >= NUM_SMALL_TYPES)
 		return;
-	}
-	if(mailbox == 1)
+	handler = (command_handler)pgm_read_word(&command_table[command].handler);
+	if(!handler)
+		return;
+	flags = pgm_read_byte(&command_table[command].flags);
+	
+	if(flags & CMD_IMMEDIATE)
 	{
-		message.ctrl.ide = 0;		 // standard CAN frame type (2.0A)
-		message.cmd = CMD_RX_DATA;   // assign this as a receiving message object.
-		message.dlc = 8;			 // Max length of a CAN message.
-		mob_number = mailbox;
-		message.pt_data = &data1[0];
-		message.id.std = id_array[1];
-		while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED);
+		handler(command_array);
+		can_latency_record(command, stamp);
 		return;
 	}
-	if(mailbox == 2)
+	
+	for (n = 0; (flags & CMD_COALESCE) && (n < cmd_queue_count); n++)
 	{
-		message.ctrl.ide = 0;		 // standard CAN frame type (2.0A)
-		message.cmd = CMD_RX_DATA;   // assign this as a receiving message object.
-		message.dlc = 8;			 // Max length of a CAN message.
-		mob_number = mailbox;
-		message.pt_data = &data2[0];
-		message.id.std = id_array[2];
-		while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED);
+		slot = (cmd_queue_head + n) % CMD_QUEUE_SIZE;
+		if(cmd_queue[slot][5] != command)
+			continue;
+		for (i = 0; i < 8; i ++)		// Same command still pending, replace it.
+		{
+			cmd_queue[slot][i] = *(command_array + i);
+		}
+#if (CAN_LATENCY_STATS)
+		cmd_queue_stamp[slot] = stamp;
+#endif
 		return;
 	}
-	if(mailbox == 3)
+	if(cmd_queue_count >= CMD_QUEUE_SIZE)
 	{
-		message.ctrl.ide = 0;		 // standard CAN frame type (2.0A)
-		message.cmd = CMD_RX_DATA;   // assign this as a receiving message object.
-		message.dlc = 8;			 // Max length of a CAN message.
-		mob_number = mailbox;
-		message.pt_data = &data3[0];
-		message.id.std = id_array[3];
-		while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED);
+		cmd_dropped++;
 		return;
 	}
-	if(mailbox == 5)
+	slot = (cmd_queue_head + cmd_queue_count) % CMD_QUEUE_SIZE;
+	for (i = 0; i < 8; i ++)
 	{
-		message.ctrl.ide = 0;		 // standard CAN frame type (2.0A)
-		message.cmd = CMD_RX_DATA;   // assign this as a receiving message object.
-		message.dlc = 8;			 // Max length of a CAN message.
-		mob_number = mailbox;
-		message.pt_data = &data5[0];
-		message.id.std = id_array[5];
-		while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED);
+		cmd_queue[slot][i] = *(command_array + i);
+	}
+#if (CAN_LATENCY_STATS)
+	cmd_queue_stamp[slot] = stamp;
+#endif
+	cmd_queue_count++;
+	return;
+}
+
+/************************************************************************/
+/*	RUN NEXT COMMAND                                                    */
+/*																		*/
+/*	Removes the oldest command from cmd_queue[] and calls its handler.	*/
+/*	The message is copied out first so that the handler is free to call	*/
+/*	can_check_general() (which may queue new commands).					*/
+/************************************************************************/
+
+void run_next_command(void)
+{
+	uint8_t i, command;
+	uint8_t command_array[8];
+#if (CAN_LATENCY_STATS)
+	uint32_t stamp;
+#endif
+	command_handler handler;
+	
+	if(!cmd_queue_count)
 		return;
-		
+	for (i = 0; i < 8; i ++)
+	{
+		command_array[i] = cmd_queue[cmd_queue_head][i];
 	}
+#if (CAN_LATENCY_STATS)
+	stamp = cmd_queue_stamp[cmd_queue_head];
+#endif
+	command = command_array[5];
+	cmd_queue_head = (cmd_queue_head + 1) % CMD_QUEUE_SIZE;
+	cmd_queue_count--;
+	
+	handler = (command_handler)pgm_read_word(&command_table[command].handler);
+	handler(command_array);
+	can_latency_record(command, stamp);
 	return;
 }
 
+/* Acceptance filters of the receive MObs (see CAN ACCEPTANCE FILTERS in global_var.h) */
+static const can_filter can_filters[CAN_NB_FILTERS] PROGMEM =
+{
+	{CAN_FILTER0_MOB,	CAN_FILTER0_ID,	CAN_FILTER0_MASK},
+	{CAN_FILTER1_MOB,	CAN_FILTER1_ID,	CAN_FILTER1_MASK},
+};
+
+/* Compile-time checks of the table above, an array of size -1 stops the build.	*/
+/* A filter accepts the IDs from (id & mask) to (id & mask) | ~mask.				*/
+#define CAN_FILTER_FREE(mask)			(~(mask) & 0xFF)
+#define CAN_FILTER_LOW(id, mask)		((id) & (mask) & 0xFF)
+#define CAN_FILTER_HIGH(id, mask)		(CAN_FILTER_LOW(id, mask) | CAN_FILTER_FREE(mask))
+#define CAN_FILTER_ALIGNED(mask)		(((CAN_FILTER_FREE(mask) + 1) & CAN_FILTER_FREE(mask)) == 0)
+#define CAN_FILTER_INSIDE(id, mask)		((CAN_FILTER_LOW(id, mask) >= CAN_RX_ID_FIRST) && (CAN_FILTER_HIGH(id, mask) <= CAN_RX_ID_LAST))
+#define CAN_FILTERS_OVERLAP(id0, mask0, id1, mask1)	((((id0) ^ (id1)) & (mask0) & (mask1) & 0xFF) == 0)
+#define CAN_CHECK(name, condition)		typedef char name[(condition) ? 1 : -1]
+
+CAN_CHECK(can_filter0_aligned, CAN_FILTER_ALIGNED(CAN_FILTER0_MASK));
+CAN_CHECK(can_filter1_aligned, CAN_FILTER_ALIGNED(CAN_FILTER1_MASK));
+CAN_CHECK(can_filter0_inside, CAN_FILTER_INSIDE(CAN_FILTER0_ID, CAN_FILTER0_MASK));
+CAN_CHECK(can_filter1_inside, CAN_FILTER_INSIDE(CAN_FILTER1_ID, CAN_FILTER1_MASK));
+CAN_CHECK(can_filter0_1_overlap, !CAN_FILTERS_OVERLAP(CAN_FILTER0_ID, CAN_FILTER0_MASK, CAN_FILTER1_ID, CAN_FILTER1_MASK));
+CAN_CHECK(can_filters_cover, (CAN_FILTER_FREE(CAN_FILTER0_MASK) + CAN_FILTER_FREE(CAN_FILTER1_MASK) + 2)
+	== (CAN_RX_ID_LAST - CAN_RX_ID_FIRST + 1));
+CAN_CHECK(can_filter_mobs, (CAN_FILTER0_MOB != CAN_FILTER1_MOB) && !(CAN_RX_MOB_MASK & CAN_TX_MOB_MASK));
+
 /************************************************************************/
 /*		INITIALIZE CAN MESSAGE OBJECTS                                  */
 /*																		*/
 /*		This function initializes our can message objects with their ID	*/
 /*		and sets whether or not they are in transmit mode or receive.	*/
+/*		The receive MObs get the acceptance filters in can_filters[].	*/
 /************************************************************************/
 
 void can_init_mobs(void)
 {
-	/* INITIALIZE MOB0 */		 // Data reception mailbox.
-	message.pt_data = &data0[0]; // point message object to first element of data buffer
-	message.ctrl.ide = 0;		 // standard CAN frame type (2.0A)
-	message.id.std = id_array[0];  // populate ID field with ID Tag
-	message.cmd = CMD_RX_DATA;   // assign this as a receiving message object.
-	message.dlc = 8;			 // Max length of a CAN message.
-	mob_number = 0;
-	while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED); // wait for MOb to configure
-
-	/* INITIALIZE MOB1 */		 // Command reception mailbox.
-	message.pt_data = &data1[0];
-	message.ctrl.ide = 0;
-	message.id.std = id_array[1];
-	message.cmd = CMD_RX_DATA;
-	message.dlc = 8;
-	mob_number = 1;
-	while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED); // wait for MOb to configure
+	uint8_t i, mob;
 	
-	/* INITIALIZE MOB2 */		 // Housekeeping request mailbox.
-	message.pt_data = &data2[0];
-	message.ctrl.ide = 0;
-	message.id.std = id_array[2];
-	message.cmd = CMD_RX_DATA;
-	message.dlc = 8;
-	mob_number = 2;
-	while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED); // wait for MOb to configure
-	
-	/* INITIALIZE MOB3 */		 // Time-check mailbox.
-	message.pt_data = &data3[0];
-	message.ctrl.ide = 0;
-	message.id.std = id_array[3];
-	message.cmd = CMD_RX_DATA;
-	message.dlc = 8;
-	mob_number = 3;
-	while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED); // wait for MOb to configure
+	/* INITIALIZE THE RECEIVE MOBS */
+	// One MOb per acceptance filter, the frames are told apart by their BIG TYPE / SMALL TYPE.
+	for (i = 0; i < CAN_NB_FILTERS; i++)
+	{
+		mob = pgm_read_byte(&can_filters[i].mob);
+		message.pt_data = 0;			// Not used, CAN_INT_vect reads the frame straight out of CANMSG.
+		message.ctrl.ide = 0;			// standard CAN frame type (2.0A)
+		message.id.std = pgm_read_byte(&can_filters[i].id);		// populate ID field with ID Tag
+		message.mask.std = pgm_read_byte(&can_filters[i].mask);	// ID bits which have to match.
+		message.cmd = CMD_RX_DATA;		// assign this as a receiving message object.
+		message.dlc = 8;				// Max length of a CAN message.
+		while(can_cmd(&message, mob) != CAN_CMD_ACCEPTED); // wait for MOb to configure
+	}
 	
-	/* INITIALIZE MOB5 */
-	message.pt_data = &data5[0];	// point message object to first element of data buffer
-	message.ctrl.ide = 0;			// standard CAN frame type (2.0A)
-	message.id.std = id_array[5];		// populate ID field with ID Tag
-	message.cmd = CMD_RX_DATA;		// assign this as a producer message object (Housekeeping MOB).
-	message.dlc = 8;				// Max length of a CAN message.
-	mob_number = 5;
-	while(can_cmd(&message, mob_number) != CAN_CMD_ACCEPTED); // wait for MOB to configure
+	/* ENABLE RECEIVE AND TRANSMIT INTERRUPTS */
+	// The receive ring is left alone, frames received before a reset are still decoded.
+	for (mob = 0; mob < CAN_TX_CLASSES; mob++)
+	{
+		can_tx_head[mob] = 0;
+		can_tx_count[mob] = 0;
+	}
+	can_tx_busy = 0;
+	CANIE2 = CAN_RX_MOB_MASK | CAN_TX_MOB_MASK;		// Interrupt on completion of any RX or TX MOb.
+	CANGIE = (1 << ENIT)|(1 << ENRX)|(1 << ENTX)|(1 << ENOVRT);	// + CAN timer overflow (see can_time_us()).
 	
 	return;
 }
@@ -533,9 +779,9 @@ static void start_tm_packet(void)
 		delay_ms(1);
 		can_check_general();
 		wdt_reset();
-		if(new_tm_msgf)
+		if(new_tm_msgf)		// SEND_TM messages are handled by decode_command().
 		{
-			receive_tm_msg();
+			new_tm_msgf = 0;
 			waiting = 100;
 		}
 		if(current_tm_fullf)
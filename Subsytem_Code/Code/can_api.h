@@ -24,23 +24,49 @@
 	*	DEVELOPMENT HISTORY:
 	*	03/07/2015		Created.
 	*
+	*	10/16/2026		Removed can_check_housekeep(), MOb5 now goes through the receive ring.
+	*
+	*					Added can_queue_message() and can_tx_pending() for the transmit queue.
+	*
+	*					Added run_next_command() for the command queue filled by decode_command().
+	*
+	*					Removed set_up_msg() and clean_up_msg(), added Can_rx_rearm().
+	*
+	*					Added can_message_prio(), can_send_message_prio() and can_tx_room(),
+	*					can_queue_message() now takes the priority of the frame.
+	*
 */
 #include "config.h"
 #include "can_lib.h"
 #include "global_var.h"
 #if (SELF_ID == 0)
 	#include "trans_lib.h"
+	#include "pus_tp.h"
 #endif
 #include "commands.h"
 #include "port.h"
+#include "can_health.h"
+#include "hk_arq.h"
+#include "time_sync.h"
+#include "can_rate.h"
+
+/* Return values of can_queue_message() / can_send_message() */
+#define CAN_TX_QUEUED			0x00
+#define CAN_TX_FULL				0xFF
+
+/* Re-enable reception on the current MOb (see Can_set_mob()), keeping its ID, mask and DLC */
+#define Can_rx_rearm()			{ Can_clear_status_mob(); Can_config_rx(); }
 
 /* Function Prototypes								 */	
 void can_check_general(void);
-void can_check_housekeep(void);
-void can_send_message(uint8_t* data_array, uint8_t id);
+uint8_t can_send_message(uint8_t* data_array, uint8_t id);
+uint8_t can_send_message_prio(uint8_t* data_array, uint8_t id, uint8_t prio);
+uint8_t can_queue_message(uint8_t* data_array, uint8_t id, uint8_t prio);
+uint8_t can_message_prio(uint8_t* data_array, uint8_t id);
+uint8_t can_tx_pending(void);
+uint8_t can_tx_room(uint8_t prio);
 void can_init_mobs(void);
-void set_up_msg(uint8_t mailbox);
-void clean_up_msg(uint8_t mailbox);
 void decode_command(uint8_t* command_array);
+void run_next_command(void);
 /*****************************************************/
 
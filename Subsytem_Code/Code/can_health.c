@@ -0,0 +1,342 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		can_health.c
+	*
+	*	PURPOSE:	This program keeps track of the health of the CAN bus: the TX/RX error counters,
+	*				error-passive and bus-off transitions, the errors seen on each MOb and the bus
+	*				utilisation of this SSM. It also recovers from bus-off.
+	*
+	*				It also extends the CAN timer and the frame timestamps (CANSTM) to 32 bits and keeps
+	*				the service latency of each command type.
+	*
+	*	FILE REFERENCES:	can_health.h
+	*
+	*	EXTERNAL VARIABLES:	can_mob_errors, can_gen_errors, can_errp_count, can_boff_count, can_util
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	can_health_poll() is called once per main loop.
+	*
+	*	NOTES:	The CAN timer is clocked at clkIO / 8 (CANTCON = 0), which is 1 us per tick at
+	*			FOSC = 8 MHz. CAN_TOVF_vect extends it to 32 bits.
+	*
+	*			Bus utilisation only counts frames which this SSM sent or accepted, traffic between
+	*			other nodes is invisible to us.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+	*	10/16/2026			Added can_stamp_us() and can_latency_record() for frame timestamps and
+	*						command latency.
+	*
+	*	10/16/2026			Bus utilisation uses the bit rate in use (can_rate.c), and a bus-off
+	*						recovery puts can_rate back to CAN_RATE_DEFAULT.
+	*
+	*	10/17/2026			The bus utilisation no longer overflows 32 bits (frames * bits * 1000).
+	*						A controller reset restarts CANTIM from 0, can_time_carry() now keeps
+	*						can_time_us() going from where it was instead of jumping by 65.536 ms.
+	*
+	*	10/17/2026			The command latency statistics are only kept with CAN_LATENCY_STATS (not on COMS).
+	*
+*/
+
+#include "can_health.h"
+#include "can_api.h"
+
+#define CAN_GIT_ERR_MASK	((1 << BOFFIT)|(1 << SERG)|(1 << CERG)|(1 << FERG)|(1 << AERG))
+
+static void can_count_errors(volatile uint8_t* counters, uint8_t flags);
+static void can_bus_off_recover(void);
+
+// The CAN timer overflows every 65.536 ms.
+ISR(CAN_TOVF_vect)
+{
+	can_tim_ovf++;
+}
+
+void can_health_init(void)
+{
+	uint8_t mob, i;
+	
+	for (mob = 0; mob < CAN_NB_MOB; mob++)
+	{
+		for (i = 0; i < CAN_ERR_TYPES; i++)
+		{
+			can_mob_errors[mob][i] = 0;
+		}
+	}
+	for (i = 0; i < CAN_ERR_TYPES; i++)
+	{
+		can_gen_errors[i] = 0;
+	}
+	can_tec_max = 0;
+	can_rec_max = 0;
+	can_errp_count = 0;
+	can_boff_count = 0;
+	can_errp = 0;
+	can_bus_off = 0;
+	can_boff_backoff = CAN_BOFF_MIN_POLLS;
+	can_boff_wait = 0;
+	can_boff_stable = 0;
+	can_tim_ovf = 0;
+	can_tim_base = 0;
+	can_frames = 0;
+	can_util_frames = 0;
+	can_util_start = 0;
+	can_util = 0;
+	can_rx_time = 0;
+	can_tx_time = 0;
+#if (CAN_LATENCY_STATS)
+	can_rx_age_max = 0;
+	can_rx_late = 0;
+	for (i = 0; i < CMD_LAT_SLOTS; i++)
+	{
+		cmd_lat[i].type = 0;
+	}
+#endif
+	return;
+}
+
+/************************************************************************/
+/* CAN TIME                                                             */
+/*																		*/
+/* Returns the 32-bit CAN timer in microseconds (wraps after ~71 min).	*/
+/* If the timer overflowed but CAN_TOVF_vect has not run yet (we are	*/
+/* in an ISR or interrupts are off), the overflow is added here.		*/
+/************************************************************************/
+
+uint32_t can_time_us(void)
+{
+	uint8_t sreg;
+	uint16_t low, high;
+	uint32_t base;
+	
+	sreg = SREG;
+	cli();
+	low = CANTIM;
+	high = can_tim_ovf;
+	base = can_tim_base;
+	if((CANGIT & (1 << OVRTIM)) && (low < 0x8000))
+		high++;
+	SREG = sreg;
+	return base + (((uint32_t)high << 16) | low);
+}
+
+/************************************************************************/
+/* CAN TIME CARRY                                                       */
+/*																		*/
+/* Called after a reset of the CAN controller, which restarts CANTIM	*/
+/* from 0 (CANTIM can not be written). before is can_time_us() read		*/
+/* just before the reset, can_time_us() carries on from there.			*/
+/************************************************************************/
+
+void can_time_carry(uint32_t before)
+{
+	uint8_t sreg;
+	
+	sreg = SREG;
+	cli();
+	can_tim_base = before;
+	can_tim_ovf = 0;
+	SREG = sreg;
+	return;
+}
+
+/************************************************************************/
+/* CAN STAMP                                                            */
+/*																		*/
+/* Converts a 16-bit CANSTM capture into the 32-bit time of				*/
+/* can_time_us(). The capture is assumed to be less than one timer		*/
+/* period (65.536 ms) old, which holds when called from CAN_INT_vect.	*/
+/************************************************************************/
+
+uint32_t can_stamp_us(uint16_t stamp)
+{
+	uint32_t now = can_time_us();
+	
+	return now - (uint16_t)((uint16_t)now - stamp);
+}
+
+#if (CAN_LATENCY_STATS)
+/************************************************************************/
+/* CAN LATENCY RECORD                                                   */
+/*																		*/
+/* Adds the time since start (a frame timestamp) to the latency			*/
+/* statistics of the given command type. Only the first CMD_LAT_SLOTS	*/
+/* command types which show up are tracked until the next report.		*/
+/************************************************************************/
+
+void can_latency_record(uint8_t type, uint32_t start)
+{
+	uint8_t i;
+	uint32_t latency;
+	cmd_latency* entry = 0;
+	
+	latency = (can_time_us() - start) >> CMD_LAT_SHIFT;
+	if(latency > 0xFFFF)
+		latency = 0xFFFF;
+	
+	for (i = 0; i < CMD_LAT_SLOTS; i++)
+	{
+		if(cmd_lat[i].type == type)
+		{
+			entry = &cmd_lat[i];
+			break;
+		}
+		if(!entry && !cmd_lat[i].type)
+			entry = &cmd_lat[i];
+	}
+	if(!entry)
+		return;
+	if(entry->type != type)
+	{
+		entry->type = type;
+		entry->count = 0;
+		entry->min = 0xFFFF;
+		entry->max = 0;
+		entry->sum = 0;
+	}
+	if(entry->count < 0xFFFF)
+	{
+		entry->count++;
+		entry->sum += latency;
+	}
+	if(latency < entry->min)
+		entry->min = (uint16_t)latency;
+	if(latency > entry->max)
+		entry->max = (uint16_t)latency;
+	return;
+}
+#endif
+
+/************************************************************************/
+/* CAN HEALTH MOB                                                       */
+/*																		*/
+/* Called by CAN_INT_vect with the CANSTMOB value of a MOb before its	*/
+/* status is cleared. Counts the completed frame and any error flags	*/
+/* which were raised on the MOb since it was last serviced.				*/
+/************************************************************************/
+
+void can_health_mob(uint8_t mob, uint8_t status)
+{
+	if(status & ((1 << TXOK)|(1 << RXOK)))
+		can_frames++;
+	if(mob < CAN_NB_MOB)
+		can_count_errors(can_mob_errors[mob], status);
+	return;
+}
+
+/************************************************************************/
+/* CAN HEALTH POLL                                                      */
+/*																		*/
+/* Samples the error counters and general error flags, updates the		*/
+/* bus utilisation and takes care of bus-off. After a bus-off the		*/
+/* controller is left alone for can_boff_backoff polls and then reset.	*/
+/* Each bus-off doubles the back-off (up to CAN_BOFF_MAX_POLLS), and	*/
+/* CAN_BOFF_STABLE_POLLS quiet polls bring it back to the minimum.		*/
+/************************************************************************/
+
+void can_health_poll(void)
+{
+	uint8_t git, gsta, tec, rec, sreg;
+	uint32_t now, elapsed, bits;
+	
+	sreg = SREG;
+	cli();
+	git = CANGIT;
+	CANGIT = git & CAN_GIT_ERR_MASK;		// Writing 1 clears the flag.
+	SREG = sreg;
+	gsta = CANGSTA;
+	tec = CANTEC;
+	rec = CANREC;
+	
+	can_count_errors(can_gen_errors, git);
+	if(tec > can_tec_max)
+		can_tec_max = tec;
+	if(rec > can_rec_max)
+		can_rec_max = rec;
+	
+	if(gsta & (1 << ERRP))
+	{
+		if(!can_errp && (can_errp_count < 0xFF))
+			can_errp_count++;
+		can_errp = 1;
+	}
+	else
+		can_errp = 0;
+	
+	if(can_bus_off)
+	{
+		if(can_boff_wait)
+			can_boff_wait--;
+		else
+			can_bus_off_recover();
+	}
+	else if((gsta & (1 << BOFF)) || (git & (1 << BOFFIT)))
+	{
+		if(can_boff_count < 0xFF)
+			can_boff_count++;
+		can_bus_off = 1;						// can_send_message() drops frames from now on.
+		can_boff_wait = can_boff_backoff;
+		can_boff_stable = 0;
+		if(can_boff_backoff < CAN_BOFF_MAX_POLLS)
+			can_boff_backoff <<= 1;
+	}
+	else if((can_boff_backoff > CAN_BOFF_MIN_POLLS) && (++can_boff_stable >= CAN_BOFF_STABLE_POLLS))
+	{
+		can_boff_backoff = CAN_BOFF_MIN_POLLS;
+		can_boff_stable = 0;
+	}
+	
+	now = can_time_us();
+	elapsed = now - can_util_start;
+	if(elapsed >= CAN_UTIL_WINDOW_US)
+	{
+		// per-mille = bits / (bits the bus could carry in elapsed / 1000), the * 1000 would overflow.
+		bits = (uint32_t)(uint16_t)(can_frames - can_util_frames) * CAN_FRAME_BITS;
+		bits /= (elapsed / 1000) * can_rate_kbit() / 1000;
+		if(bits > 1000)
+			bits = 1000;
+		can_util = (uint16_t)bits;
+		can_util_frames = can_frames;
+		can_util_start = now;
+	}
+	return;
+}
+
+// Helper: bits 0-3 of CANSTMOB and CANGIT are AERR, FERR, CERR, SERR in that order.
+static void can_count_errors(volatile uint8_t* counters, uint8_t flags)
+{
+	uint8_t i;
+	
+	for (i = 0; i < CAN_ERR_TYPES; i++)
+	{
+		if((flags & (1 << i)) && (counters[i] < 0xFF))
+			counters[i]++;
+	}
+	return;
+}
+
+// Helper: resets the CAN controller and sets the MObs back up. Anything still
+// waiting to be sent is lost and counted in can_tx_dropped.
+static void can_bus_off_recover(void)
+{
+	uint32_t before;
+	
+	can_tx_dropped += can_tx_pending();
+	before = can_time_us();
+	Can_reset();
+	can_init(0);					// Always comes back at CAN_BAUDRATE.
+	can_rate = CAN_RATE_DEFAULT;
+	can_init_mobs();
+	can_time_carry(before);			// The CAN timer restarted from 0.
+	can_util_frames = can_frames;
+	can_util_start = can_time_us();
+	can_bus_off = 0;
+	return;
+}
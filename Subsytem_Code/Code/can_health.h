@@ -0,0 +1,53 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		can_health.h
+	*
+	*	PURPOSE:	This program contains the prototypes for can_health.c
+	*
+	*	FILE REFERENCES:	io.h, interrupt.h, can_api.h, can_drv.h
+	*
+	*	EXTERNAL VARIABLES:	
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+	*	10/16/2026			Added can_stamp_us() and can_latency_record().
+	*
+	*	10/17/2026			Added can_time_carry().
+	*
+	*	10/17/2026			can_latency_record() is only there with CAN_LATENCY_STATS.
+	*
+*/
+
+#ifndef CAN_HEALTH_H
+#define CAN_HEALTH_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "global_var.h"
+#include "can_lib.h"
+
+void can_health_init(void);
+void can_health_poll(void);
+void can_health_mob(uint8_t mob, uint8_t status);
+uint32_t can_time_us(void);
+void can_time_carry(uint32_t before);
+uint32_t can_stamp_us(uint16_t stamp);
+#if (CAN_LATENCY_STATS)
+void can_latency_record(uint8_t type, uint32_t start);
+#else
+#define can_latency_record(type, start)		// Not kept (see CAN_LATENCY_STATS).
+#endif
+
+#endif
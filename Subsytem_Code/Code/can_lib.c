@@ -49,6 +49,14 @@
 	*					I FOUND A BUG IN THE CODE THAT WAS GIVEN TO ME. They made use of a temporary
 	*					32-bit integer which does not work on an 8-bit architecture. This was the cause
 	*					of the errors I had in terms of receiving a message from an ID that did not match.
+	*
+	*	10/16/2026		CMD_RX_DATA takes its acceptance mask from cmd->mask instead of always
+	*					comparing 8 bits. This also fixes the mask being read out of an 8-bit
+	*					variable by Can_set_std_msk(), which set ID bits 10-8 of the mask to garbage.
+	*
+	*	10/17/2026		CMD_RX_DATA / CMD_RX_REMOTE no longer call Can_set_ext_msk() after Can_set_std_msk().
+	*					It overwrote CANIDM1-4 with bytes read past an 8-bit variable, so the mask set
+	*					from cmd->mask never reached the MOb. Only CANIDM3/4 are cleared now.
 */
 
 //_____ I N C L U D E S ________________________________________________________
@@ -175,13 +183,12 @@ uint8_t can_cmd(st_cmd_t* cmd, uint8_t mob_number)
         //------------      
         case CMD_RX_DATA:
 		
-          u8_temp = 0xFF;				// Compares 8 bits of the ID.
-		  Can_set_std_msk(u8_temp);
+		  CANIDM3 = 0;					// Only used by extended IDs.
+		  CANIDM4 = 0;					// RTRMSK / IDEMSK, set again below.
+		  Can_set_std_msk(cmd->mask.std);	// Acceptance mask, the bits set are compared.
 		  
 		  Can_set_std_id(cmd->id.std);	// New ID of the MOB is from the cmd object.
 		  
-		  u8_temp = 0;
-		  Can_set_ext_msk(u8_temp);
           Can_set_dlc(cmd->dlc);		// For simplicity, should always be 8.
 		  
           cmd->ctrl.rtr=0; 
@@ -194,13 +201,12 @@ uint8_t can_cmd(st_cmd_t* cmd, uint8_t mob_number)
           break;
         //------------      
         case CMD_RX_REMOTE:
-		  u8_temp = 0xFF;				// Compares 8 bits of the ID.
-		  Can_set_std_msk(u8_temp);
+		  CANIDM3 = 0;
+		  CANIDM4 = 0;
+		  Can_set_std_msk(cmd->mask.std);	// Acceptance mask, the bits set are compared.
 				  
 		  Can_set_std_id(cmd->id.std);	// New ID of the MOB is from the cmd object.
 		
-          u8_temp=0; 
-		  Can_set_ext_msk(u8_temp);
           Can_set_dlc(cmd->dlc);
 		  
           cmd->ctrl.rtr=1; 
@@ -39,6 +39,8 @@
 	*
 	*	02/06/2015		Edited the header.
 	*
+	*	10/16/2026		Added the mask field to st_cmd_t for CMD_RX_DATA.
+	*
 */
 
 
@@ -121,10 +123,12 @@ typedef struct{
 //             received.
 // 6) status:  manage by the library.
 // 7) ctrl  :  field ide to signal a extended frame .
+// 8) mask  :  acceptance mask for CMD_RX_DATA / CMD_RX_REMOTE (ID bits which are compared).
 typedef  struct{
   uint8_t         handle; 
   can_cmd_t  cmd; 
   can_id_t   id;
+  can_id_t   mask;
   uint8_t         dlc;  
   uint8_t*        pt_data; 
   uint8_t         status; 
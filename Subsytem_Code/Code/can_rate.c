@@ -0,0 +1,212 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		can_rate.c
+	*
+	*	PURPOSE:	This program lets the OBC move the whole bus to a faster bit rate (500 kbit or
+	*				1 Mbit) at run time, falls back to CAN_BAUDRATE if the new rate does not work, and
+	*				measures how many frames per second this SSM actually gets out at the current rate.
+	*
+	*	FILE REFERENCES:	can_rate.h
+	*
+	*	EXTERNAL VARIABLES:	can_rate, can_rate_state, can_rate_next, can_rate_at, can_rate_frames,
+	*						can_rate_fallbacks
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	can_rate_poll() is called once per main loop, after
+	*											can_health_poll().
+	*
+	*	NOTES:	CAN_RATE_SWITCH is broadcast by the OBC. Every node receives the frame at the same
+	*			moment, so switching [3:2] ms after its timestamp (can_rx_time) moves all of them at
+	*			once. The OBC has to stop sending for that long, frames still queued here when the
+	*			switch happens are dropped and counted in can_tx_dropped.
+	*
+	*			After the switch the first frame which is sent or received without error confirms
+	*			the new rate (a frame we send is only complete once another node has acknowledged
+	*			it). If we go error-passive or nothing is seen for CAN_RATE_TRIAL_US we go back to
+	*			CAN_RATE_DEFAULT. A bus-off always comes back at CAN_RATE_DEFAULT (can_init()).
+	*
+	*			CAN_RATE_TEST sends a burst of HK_RATE_TEST frames and reports the frames per second
+	*			measured from the first frame queued to the last one acknowledged. The OBC runs it
+	*			once per profile to compare the rates.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+	*	10/17/2026			can_rate_apply() carries the CAN time over the controller reset
+	*						(can_time_carry()) instead of bumping can_tim_ovf.
+	*
+*/
+
+#include "can_rate.h"
+#include "can_api.h"
+#include <avr/pgmspace.h>
+
+#if (FOSC != 8000)
+#	error The CAN bit rate profiles are only defined for FOSC == 8000
+#endif
+
+/* Bit timing of each profile, the first one is whatever config.h chose for can_init() */
+static const can_rate_profile can_rate_table[CAN_RATE_PROFILES] PROGMEM =
+{
+	{CAN_BAUDRATE,	CONF_CANBT1,	CONF_CANBT2,	CONF_CANBT3},
+	{500,			0x02,	0x04,	0x13},		// Tscl = 250 ns, 8x Tscl, sampling at 75%
+	{1000,			0x00,	0x04,	0x13},		// Tscl = 125 ns, 8x Tscl, sampling at 75%
+};
+
+void can_rate_init(void)
+{
+	can_rate = CAN_RATE_DEFAULT;
+	can_rate_state = CAN_RATE_STABLE;
+	can_rate_fallbacks = 0;
+	return;
+}
+
+uint16_t can_rate_kbit(void)
+{
+	return pgm_read_word(&can_rate_table[can_rate].kbit);
+}
+
+/************************************************************************/
+/* CAN RATE APPLY                                                       */
+/*																		*/
+/* Resets the CAN controller with the bit timing of the given profile	*/
+/* and sets the MObs back up. Anything still waiting to be sent is		*/
+/* lost and counted in can_tx_dropped.									*/
+/************************************************************************/
+
+void can_rate_apply(uint8_t profile)
+{
+	uint32_t before;
+	
+	can_tx_dropped += can_tx_pending();
+	before = can_time_us();
+	Can_reset();
+	CANBT1 = pgm_read_byte(&can_rate_table[profile].bt1);
+	CANBT2 = pgm_read_byte(&can_rate_table[profile].bt2);
+	CANBT3 = pgm_read_byte(&can_rate_table[profile].bt3);
+	can_clear_all_mob();
+	Can_enable();
+	can_init_mobs();
+	can_time_carry(before);			// The CAN timer restarted from 0.
+	can_rate = profile;
+	can_util_frames = can_frames;
+	can_util_start = can_time_us();
+	return;
+}
+
+/************************************************************************/
+/* CAN RATE POLL                                                        */
+/*																		*/
+/* Carries out a scheduled switch and decides whether the new rate		*/
+/* works.																*/
+/************************************************************************/
+
+void can_rate_poll(void)
+{
+	uint32_t now;
+	
+	if(can_rate_state == CAN_RATE_STABLE)
+		return;
+	now = can_time_us();
+	if(can_rate_state == CAN_RATE_SCHEDULED)
+	{
+		if((int32_t)(now - can_rate_at) < 0)
+			return;
+		can_rate_apply(can_rate_next);
+		can_rate_state = CAN_RATE_TRIAL;
+		can_rate_at = can_time_us();
+		can_rate_frames = can_frames;
+		return;
+	}
+	if(can_rate == CAN_RATE_DEFAULT)		// A bus-off recovery got here first.
+	{
+		if(can_rate_fallbacks < 0xFF)
+			can_rate_fallbacks++;
+		can_rate_state = CAN_RATE_STABLE;
+		return;
+	}
+	if(can_errp || ((now - can_rate_at) > CAN_RATE_TRIAL_US))
+	{
+		can_rate_apply(CAN_RATE_DEFAULT);
+		if(can_rate_fallbacks < 0xFF)
+			can_rate_fallbacks++;
+		can_rate_state = CAN_RATE_STABLE;
+	}
+	else if(can_frames != can_rate_frames)
+		can_rate_state = CAN_RATE_STABLE;	// The bus works at the new rate.
+	return;
+}
+
+/************************************************************************/
+/* CAN RATE SWITCH                                                      */
+/*																		*/
+/* Handler for CAN_RATE_SWITCH, schedules the switch.					*/
+/************************************************************************/
+
+void can_rate_switch(uint8_t* command)
+{
+	uint16_t delay_ms = ((uint16_t)*(command + 3) << 8) | *(command + 2);
+	
+	if(*(command + 4) >= CAN_RATE_PROFILES)
+		return;
+	can_rate_next = *(command + 4);
+	can_rate_at = can_rx_time + (uint32_t)delay_ms * 1000;
+	can_rate_state = CAN_RATE_SCHEDULED;
+	return;
+}
+
+/************************************************************************/
+/* CAN RATE TEST                                                        */
+/*																		*/
+/* Sends [4] HK_RATE_TEST frames back to back and then the result:		*/
+/*	[4] 0xFF, [3] profile, [2] frames queued, [1:0] frames per second	*/
+/************************************************************************/
+
+void can_rate_test(uint8_t* command)
+{
+	uint8_t i, count, sent = 0;
+	uint16_t fps = 0;
+	uint32_t start, elapsed;
+	
+	count = *(command + 4);
+	if(!count)
+		count = CAN_RATE_TEST_FRAMES;
+	if(count == 0xFF)
+		count = 0xFE;						// 0xFF marks the result.
+	
+	send_arr[7] = (SELF_ID << 4)|HK_TASK_ID;
+	send_arr[6] = MT_HK;
+	send_arr[5] = HK_RATE_TEST;
+	send_arr[3] = 0x55;						// Worst case bit stuffing does not matter here,
+	send_arr[2] = 0xAA;						// just something recognisable.
+	send_arr[1] = 0x55;
+	send_arr[0] = 0xAA;
+	
+	start = can_time_us();
+	while(can_tx_pending() && ((can_time_us() - start) < CAN_RATE_TEST_US));	// Start with an empty queue.
+	start = can_time_us();
+	for (i = 0; i < count; i++)
+	{
+		send_arr[4] = i;
+		if(can_send_message(&(send_arr[0]), CAN1_MB6) == CAN_TX_QUEUED)
+			sent++;
+	}
+	while(can_tx_pending() && ((can_time_us() - start) < CAN_RATE_TEST_US));
+	elapsed = can_tx_time - start;			// Timestamp of the last frame acknowledged.
+	if(sent && !can_tx_pending() && elapsed)
+		fps = (uint16_t)(((uint32_t)sent * 1000000) / elapsed);
+	
+	send_arr[4] = 0xFF;
+	send_arr[3] = can_rate;
+	send_arr[2] = sent;
+	send_arr[1] = (uint8_t)(fps >> 8);
+	send_arr[0] = (uint8_t)fps;
+	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
+	return;
+}
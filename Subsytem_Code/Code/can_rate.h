@@ -0,0 +1,40 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		can_rate.h
+	*
+	*	PURPOSE:	This program contains the prototypes for can_rate.c
+	*
+	*	FILE REFERENCES:	global_var.h, can_lib.h
+	*
+	*	EXTERNAL VARIABLES:	
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+*/
+
+#ifndef CAN_RATE_H
+#define CAN_RATE_H
+
+#include "global_var.h"
+#include "can_lib.h"
+
+void can_rate_init(void);
+void can_rate_poll(void);
+void can_rate_apply(uint8_t profile);
+uint16_t can_rate_kbit(void);
+void can_rate_switch(uint8_t* command);
+void can_rate_test(uint8_t* command);
+
+#endif
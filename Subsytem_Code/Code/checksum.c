@@ -0,0 +1,156 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		checksum.c
+	*
+	*	PURPOSE:	This program contains the checksums used on PUS packets and housekeeping reports:
+	*				Fletcher-16 (the one the ground and the OBC check) and CRC-16/CCITT.
+	*
+	*	FILE REFERENCES:	checksum.h
+	*
+	*	EXTERNAL VARIABLES:	None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
+	*
+	*	NOTES:	The old fletcher16() took two '% 255' per byte, which is a call to the 16-bit division
+	*			routine on the AVR. Here the sums are only reduced every FLETCHER_BLOCK bytes, which
+	*			is the most that fits in 16 bits, and the reduction is done by folding the high byte
+	*			into the low one (256 == 1 mod 255). The result is the same as before for any input.
+	*
+	*			fletcher16_init() / fletcher16_add() / fletcher16_update() / fletcher16_final() let
+	*			the checksum be built up while the bytes arrive (SPI, CAN) instead of in a second pass.
+	*
+	*			crc16_ccitt() is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, CRC of "123456789" is
+	*			0x29B1). It uses a 16-entry table in flash, two lookups per byte.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026			Created. fletcher16() was moved here from trans_lib.c.
+	*
+*/
+
+#include "checksum.h"
+#include <avr/pgmspace.h>
+
+static uint16_t fletcher_fold(uint16_t sum);
+
+static const uint16_t crc16_table[16] PROGMEM =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+void fletcher16_init(fletcher_state* f)
+{
+	f->sum1 = 0;
+	f->sum2 = 0;
+	f->left = FLETCHER_BLOCK;
+	return;
+}
+
+void fletcher16_add(fletcher_state* f, uint8_t byte)
+{
+	f->sum1 += byte;
+	f->sum2 += f->sum1;
+	if(!(--f->left))
+	{
+		f->sum1 = fletcher_fold(f->sum1);
+		f->sum2 = fletcher_fold(f->sum2);
+		f->left = FLETCHER_BLOCK;
+	}
+	return;
+}
+
+void fletcher16_update(fletcher_state* f, uint8_t* data, uint16_t count)
+{
+	uint16_t sum1 = f->sum1, sum2 = f->sum2;
+	uint8_t left = f->left;
+	
+	while(count--)
+	{
+		sum1 += *data++;
+		sum2 += sum1;
+		if(!(--left))
+		{
+			sum1 = fletcher_fold(sum1);
+			sum2 = fletcher_fold(sum2);
+			left = FLETCHER_BLOCK;
+		}
+	}
+	f->sum1 = sum1;
+	f->sum2 = sum2;
+	f->left = left;
+	return;
+}
+
+/************************************************************************/
+/* FLETCHER16_FINAL		                                                */
+/* @Purpose: Reduces the running sums to what fletcher16() would have	*/
+/* returned for the same bytes.											*/
+/* @return: (sum2 << 8) | sum1											*/
+/************************************************************************/
+uint16_t fletcher16_final(fletcher_state* f)
+{
+	uint16_t sum1, sum2;
+	
+	sum1 = fletcher_fold(f->sum1);
+	sum2 = fletcher_fold(f->sum2);
+	if(sum1 >= 255)
+		sum1 -= 255;
+	if(sum2 >= 255)
+		sum2 -= 255;
+	return (sum2 << 8) | sum1;
+}
+
+/************************************************************************/
+/* FLETCHER16				                                            */
+/* @Purpose: This function runs Fletcher's checksum algorithm on spimem	*/
+/* @param: *data: pointer to the point in memory that you would to start*/
+/* hashing.																*/
+/* @param: count: how many BYTES in memory, you would like to hash		*/
+/* @return: the 16-bit checksum value.									*/
+/************************************************************************/
+uint16_t fletcher16(uint8_t* data, int count)
+{
+	fletcher_state f;
+	
+	fletcher16_init(&f);
+	fletcher16_update(&f, data, (uint16_t)count);
+	return fletcher16_final(&f);
+}
+
+/************************************************************************/
+/* CRC16_CCITT			                                                */
+/* @Purpose: CRC-16/CCITT of count bytes, continuing from crc. Start	*/
+/* with crc16_ccitt() (or crc = 0xFFFF) and feed the rest through		*/
+/* crc16_ccitt_update() as it arrives.									*/
+/************************************************************************/
+uint16_t crc16_ccitt_update(uint16_t crc, uint8_t* data, uint16_t count)
+{
+	uint8_t byte;
+	
+	while(count--)
+	{
+		byte = *data++;
+		crc = (crc << 4) ^ pgm_read_word(&crc16_table[(uint8_t)(crc >> 12) ^ (byte >> 4)]);
+		crc = (crc << 4) ^ pgm_read_word(&crc16_table[(uint8_t)(crc >> 12) ^ (byte & 0x0F)]);
+	}
+	return crc;
+}
+
+uint16_t crc16_ccitt(uint8_t* data, uint16_t count)
+{
+	return crc16_ccitt_update(0xFFFF, data, count);
+}
+
+// Helper: 256 == 1 (mod 255), two folds bring any 16-bit sum down to 0..256.
+static uint16_t fletcher_fold(uint16_t sum)
+{
+	sum = (sum & 0xFF) + (sum >> 8);
+	return (sum & 0xFF) + (sum >> 8);
+}
@@ -0,0 +1,40 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		checksum.h
+	*
+	*	PURPOSE:	This program contains the prototypes for checksum.c
+	*
+	*	FILE REFERENCES:	global_var.h
+	*
+	*	EXTERNAL VARIABLES:	
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026			Created.
+	*
+*/
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "global_var.h"
+
+void fletcher16_init(fletcher_state* f);
+void fletcher16_add(fletcher_state* f, uint8_t byte);
+void fletcher16_update(fletcher_state* f, uint8_t* data, uint16_t count);
+uint16_t fletcher16_final(fletcher_state* f);
+uint16_t fletcher16(uint8_t* data, int count);
+uint16_t crc16_ccitt_update(uint16_t crc, uint8_t* data, uint16_t count);
+uint16_t crc16_ccitt(uint8_t* data, uint16_t count);
+
+#endif
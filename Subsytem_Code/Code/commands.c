@@ -11,7 +11,7 @@
 	*
 	*	FILE REFERENCES:		commands.h
 	*
-	*	EXTERNAL VARIABLES:		send_now, send_data, send_hk, send_coms
+	*	EXTERNAL VARIABLES:		cmd_queue, cmd_queue_count
 	*
 	*	EXTERNAL REFERENCES:	Same a File References.
 	*
@@ -44,75 +44,45 @@
 #include "commands.h"
 
 #if (SELF_ID == 0)
-static void store_current_tm(void);
 static void send_tc_can_msg(uint8_t packet_count);
 #endif
 
 /************************************************************************/
 /* RUN COMMANDS                                                         */
 /*																		*/
-/* This function loops through a list of global command flags and		*/
-/*	executes the corresponding command function if they are equal to 1.	*/
+/* This function carries out the commands which decode_command() has	*/
+/* queued, then checks the flags for work that this SSM starts itself.	*/
 /************************************************************************/
 
 void run_commands(void)
 {
-	if (send_now)
-		send_response();
-	if (send_hk)
-		send_housekeeping();
-	if (send_data)
-		send_sensor_data();
+	uint8_t pending = cmd_queue_count;
+	
+	while(pending--)			// Commands queued while these run wait for the next loop.
+		run_next_command();
+	
 	if (msg_received)
 		send_coms_packet();
-	if (read_response)
-		send_read_response();
-	if (write_response)
-		send_write_response();
-	if (set_sens_h)
-		set_sensor_high();
-	if (set_sens_l)
-		set_sensor_low();
-	if (set_varf)
-		set_var();
 #if (SELF_ID == 0)
 	if (alert_deployf)
 		alert_deploy();
-	if (new_tm_msgf)
-		receive_tm_msg();
+#if (PUS_SEGMENTED)
+	tp_poll();					// Sends the TCs in packet_list[] without waiting.
+#else
 	if (packet_count)
 	{
 		load_packet_to_current_tc();
 		send_pus_packet_tc();
+		release_current_tc();
 	}
+#endif
 	if (ask_alive)
 		send_ask_alive();
-	if (enter_take_overf)
-		//enter_take_over();
-	if (exit_take_overf)
-		exit_take_over();
 #endif
 	if (event_readyf)
 		send_event();
-#if (SELF_ID == 1)
-	if (enter_low_powerf)
-		enter_low_power();
-	if (exit_low_powerf)
-		exit_low_power();
-	if (deploy_antennaf)
-		deploy_antenna();
-	if (turn_off_deployf)
-		turn_off_deploy();
-#endif
-	if (pause_operationsf)
-		//pause_operations();
-	if (resume_operationsf)
-		resume_operations();
-#if (SELF_ID == 2)
-	if (open_valvesf)
-		open_valves();
-	if (collect_pdf)
-		collect_pd();
+#if (HK_PACKED)
+	hk_arq_poll();				// Sends unacknowledged housekeeping frames again.
 #endif
 
 	return;	
@@ -124,7 +94,7 @@ void run_commands(void)
 /* Thia function sends a generic response to the generic "REQ_RESPONSE	*/
 /* which was issued by the OBC.											*/
 /************************************************************************/
-void send_response(void)
+void send_response(uint8_t* command)
 {
 	send_arr[7] = (SELF_ID << 4)|OBC_ID;
 	send_arr[6] = MT_COM;
@@ -132,241 +102,421 @@ void send_response(void)
 	send_arr[4] = CURRENT_MINUTE;
 
 	can_send_message(&(send_arr[0]), CAN1_MB7);		//CAN1_MB7 is the command reception MB.
-	send_now = 0;
 	return;
 }
 
 /************************************************************************/
-/* SEND HOUSEKEEPING                                                    */
+/* COLLECT HOUSEKEEPING                                                 */
 /*																		*/
-/* This function is intended to be used to send housekeeping to the OBC.*/
-/* It is likely that more than 4 bytes will be required to send the HK	*/
-/* from a particular subsystem and hence this function will send a		*/
-/* series of CAN messages to the OBC each one with a different smalltype*/
+/* Fills names[] and values[] with this SSM's housekeeping values and	*/
+/* returns how many there are (at most HK_MAX_VALUES). The order of		*/
+/* this list is also the layout of the packed housekeeping report, so	*/
+/* the OBC needs to be updated if it changes.							*/
 /************************************************************************/
 
-void send_housekeeping(void)
-{	
+static void add_hk_value(uint8_t* names, uint16_t* values, uint8_t* count, uint8_t name, uint16_t value)
+{
+	if(*count >= HK_MAX_VALUES)
+		return;
+	names[*count] = name;
+	values[*count] = value;
+	(*count)++;
+	return;
+}
+
+static uint8_t collect_housekeeping(uint8_t* names, uint16_t* values)
+{
+	uint8_t count = 0;
 	uint16_t temp;
-	send_arr[7] = (SELF_ID << 4)|HK_TASK_ID;
-	send_arr[6] = MT_HK;	// HK will likely require multiple message in the future.
-	send_arr[1] = 0;
-	send_arr[0] = 0;
 
 #if (SELF_ID == 0)
-	//if(receiving_tmf)		// Housekeeping takes a while, don't do it while receiving a TM packet.
-	//	return;
-	//delay_ms(60);
 	// Temperature Collection
-	send_arr[4] = COMS_TEMP;
-	temp = spi_retrieve_temp(COMS_TEMP_SS);
-	send_arr[1] = (uint8_t)(temp >> 8);			// SPI temperature sensor readings.
-	send_arr[0] = (uint8_t)(temp);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	//delay_ms(100);
+	temp = spi_retrieve_temp(COMS_TEMP_SS);			// SPI temperature sensor readings.
+	coms_temp = temp;								// Also used to decide when to calibrate the CC1120.
+	add_hk_value(names, values, &count, COMS_TEMP, temp);
+	// UHF link quality (averages, see send_rf_link() for the rest)
+	add_hk_value(names, values, &count, COMS_RSSI, (uint16_t)(rf_rssi.avg8 >> 3));
+	add_hk_value(names, values, &count, COMS_LQI, (uint16_t)(rf_lqi.avg8 >> 3));
+	add_hk_value(names, values, &count, COMS_FREQOFF, (uint16_t)(rf_freqoff.avg8 >> 3));
+	add_hk_value(names, values, &count, COMS_RF_REJECTED, rf_rejected);
 #endif
 
 #if (SELF_ID == 1)
-	delay_ms(50);
 	// EPS Temp Collection
-	send_arr[4] = EPS_TEMP;
-	epstemp = spi_retrieve_temp(EPS_TEMP_CS);
-	send_arr[1] = (uint8_t)(epstemp >> 8);			// SPI temperature sensor readings.
-	send_arr[0] = (uint8_t)(epstemp);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
+	epstemp = spi_retrieve_temp(EPS_TEMP_CS);		// SPI temperature sensor readings.
+	add_hk_value(names, values, &count, EPS_TEMP, epstemp);
 	// Panel Voltage / Current Collection
-	send_arr[4] = PANELX_V;
-	send_arr[1] = (uint8_t)(pxv >> 8);
-	send_arr[0] = (uint8_t)pxv;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = PANELX_I;
-	send_arr[1] = (uint8_t)(pxi >> 8);
-	send_arr[0] = (uint8_t)pxi;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = PANELY_V;
-	send_arr[1] = (uint8_t)(pyv >> 8);
-	send_arr[0] = (uint8_t)pyv;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = PANELY_I;
-	send_arr[1] = (uint8_t)(pyi >> 8);
-	send_arr[0] = (uint8_t)pyi;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	
-	send_arr[4] = BATT_V;
-	send_arr[1] = (uint8_t)(battv >> 8);
-	send_arr[0] = (uint8_t)battv;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = BATTIN_I;
-	send_arr[1] = (uint8_t)(battin >> 8);
-	send_arr[0] = (uint8_t)battin;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = BATTOUT_I;
-	send_arr[1] = (uint8_t)(battout >> 8);
-	send_arr[0] = (uint8_t)battout;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-
+	add_hk_value(names, values, &count, PANELX_V, pxv);
+	add_hk_value(names, values, &count, PANELX_I, pxi);
+	add_hk_value(names, values, &count, PANELY_V, pyv);
+	add_hk_value(names, values, &count, PANELY_I, pyi);
+	// Battery Collection
+	add_hk_value(names, values, &count, BATT_V, battv);
+	add_hk_value(names, values, &count, BATTIN_I, battin);
+	add_hk_value(names, values, &count, BATTOUT_I, battout);
 	// Subsystem Voltages and Current Collection
-	send_arr[4] = COMS_V;
-	send_arr[1] = (uint8_t)(comsv >> 8);
-	send_arr[0] = (uint8_t)comsv;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = COMS_I;
-	send_arr[1] = (uint8_t)(comsi >> 8);
-	send_arr[0] = (uint8_t)comsi;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = PAY_V;
-	send_arr[1] = (uint8_t)(payv >> 8);
-	send_arr[0] = (uint8_t)payv;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = PAY_I;
-	send_arr[1] = (uint8_t)(payi >> 8);
-	send_arr[0] = (uint8_t)payi;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = OBC_V;
-	send_arr[1] = (uint8_t)(obcv >> 8);
-	send_arr[0] = (uint8_t)obcv;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = OBC_I;
-	send_arr[1] = (uint8_t)(obci >> 8);
-	send_arr[0] = (uint8_t)obci;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = MPPTX;
-	send_arr[1] = (uint8_t)(mpptx >> 8);
-	send_arr[0] = (uint8_t)mpptx;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(100);
-	send_arr[4] = MPPTY;
-	send_arr[1] = (uint8_t)(mppty >> 8);
-	send_arr[0] = (uint8_t)mppty;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
+	add_hk_value(names, values, &count, COMS_V, comsv);
+	add_hk_value(names, values, &count, COMS_I, comsi);
+	add_hk_value(names, values, &count, PAY_V, payv);
+	add_hk_value(names, values, &count, PAY_I, payi);
+	add_hk_value(names, values, &count, OBC_V, obcv);
+	add_hk_value(names, values, &count, OBC_I, obci);
+	add_hk_value(names, values, &count, MPPTX, mpptx);
+	add_hk_value(names, values, &count, MPPTY, mppty);
 #endif
 
 #if (SELF_ID == 2)
-	delay_ms(10);		// Used to stagger the responses of the SSMs.
 	// Environmental Sensor Collection
-	send_arr[4] = PAY_TEMP0;
-	temp = spi_retrieve_temp(PAY_TEMP_CS);	// Get raw temp reading
-	send_arr[1] = (uint8_t)(temp >> 8);			// SPI temperature sensor readings.
-	send_arr[0] = (uint8_t)(temp);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	send_arr[4] = PAY_PRESS;
+	temp = spi_retrieve_temp(PAY_TEMP_CS);			// Get raw temp reading
+	add_hk_value(names, values, &count, PAY_TEMP0, temp);
 	temp = collect_pressure();
 	if(temp > 1200)
 		temp = 1200;
 	if(temp < 800)
 		temp = 800;
-	send_arr[1] = (uint8_t)(temp >> 8);
-	send_arr[0] = (uint8_t)temp;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
+	add_hk_value(names, values, &count, PAY_PRESS, temp);
 	temp = spi_retrieve_acc(1);
 	if(temp > 2000)
 		temp = 0xFFFF - temp;
-	send_arr[4] = PAY_ACCEL_X;
-	send_arr[1] = (uint8_t)(temp >> 8);
-	send_arr[0] = (uint8_t)temp;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
+	add_hk_value(names, values, &count, PAY_ACCEL_X, temp);
 	temp = spi_retrieve_acc(2);
 	if(temp > 2000)
-	temp = 0xFFFF - temp;
-	send_arr[4] = PAY_ACCEL_Y;
-	send_arr[1] = (uint8_t)(temp >> 8);
-	send_arr[0] = (uint8_t)temp;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
+		temp = 0xFFFF - temp;
+	add_hk_value(names, values, &count, PAY_ACCEL_Y, temp);
 	temp = spi_retrieve_acc(3);
 	if(temp > 2000)
-	temp = 0xFFFF - temp;
-	send_arr[4] = PAY_ACCEL_Z;
-	send_arr[1] = (uint8_t)(temp >> 8);
-	send_arr[0] = (uint8_t)temp;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	send_arr[4] = PAY_FL_PD5;
-	send_arr[1] = 0;
-	send_arr[0] = 0xAA;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	send_arr[4] = PAY_FL_PD0;
-	send_arr[1] = 0;
-	send_arr[0] = 0x55;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	send_arr[4] = PAY_FL_PD1;
-	send_arr[1] = 0;
-	send_arr[0] = 0x66;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	send_arr[4] = PAY_FL_PD2;
-	send_arr[1] = 0;
-	send_arr[0] = 0x77;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	send_arr[4] = PAY_FL_PD3;
-	send_arr[1] = 0;
-	send_arr[0] = 0x88;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	send_arr[4] = PAY_FL_PD4;
-	send_arr[1] = 0;
-	send_arr[0] = 0x99;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
-	send_arr[4] = PAY_FL_PD5;
-	send_arr[1] = 0;
-	send_arr[0] = 0xAA;
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(1);
-	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
-	delay_ms(10);
+		temp = 0xFFFF - temp;
+	add_hk_value(names, values, &count, PAY_ACCEL_Z, temp);
+	// Photodiodes (placeholder values)
+	add_hk_value(names, values, &count, PAY_FL_PD0, 0x55);
+	add_hk_value(names, values, &count, PAY_FL_PD1, 0x66);
+	add_hk_value(names, values, &count, PAY_FL_PD2, 0x77);
+	add_hk_value(names, values, &count, PAY_FL_PD3, 0x88);
+	add_hk_value(names, values, &count, PAY_FL_PD4, 0x99);
+	add_hk_value(names, values, &count, PAY_FL_PD5, 0xAA);
+#endif
+
+	return count;
+}
+
+/************************************************************************/
+/* SEND HOUSEKEEPING                                                    */
+/*																		*/
+/* This function is intended to be used to send housekeeping to the OBC.*/
+/*																		*/
+/* HK_PACKED == 1: values are sent two per frame (HK_PACKED_FRAME) with	*/
+/* a frame sequence number in byte 4, followed by a single				*/
+/* HK_PACKED_END frame which holds the number of frames/values, a		*/
+/* report counter and a Fletcher-16 checksum over the value bytes.		*/
+/*																		*/
+/* HK_PACKED == 0: one HK_SINGLE frame is sent per sensor with the		*/
+/* sensor name in byte 4 (the original format).							*/
+/*																		*/
+/* hk_pacing_ms is inserted between frames to cap the bus load.			*/
+/************************************************************************/
+
+void send_housekeeping(uint8_t* command)
+{	
+	uint8_t names[HK_MAX_VALUES];
+	uint16_t values[HK_MAX_VALUES];
+	uint8_t count, i;
+#if (HK_PACKED)
+	uint8_t frame = 0, j;
+	uint16_t pec;
+	fletcher_state f;
+#endif
+
+#if (SELF_ID == 1)
+	delay_ms(50);
+#endif
+#if (SELF_ID == 2)
+	delay_ms(10);		// Used to stagger the responses of the SSMs.
+#endif
+	count = collect_housekeeping(names, values);
+
+#if (HK_PACKED)
+	hk_arq_new_report();			// The report is kept in hk_tx_data[] until the OBC acknowledges it.
+	fletcher16_init(&f);
+	for(i = 0; i < count; i += 2)
+	{
+		hk_tx_data[frame][3] = (uint8_t)(values[i] >> 8);
+		hk_tx_data[frame][2] = (uint8_t)values[i];
+		if((i + 1) < count)
+		{
+			hk_tx_data[frame][1] = (uint8_t)(values[i + 1] >> 8);
+			hk_tx_data[frame][0] = (uint8_t)values[i + 1];
+		}
+		else
+		{
+			hk_tx_data[frame][1] = 0;
+			hk_tx_data[frame][0] = 0;
+		}
+		for (j = 4; j > 0; j--)
+			fletcher16_add(&f, hk_tx_data[frame][j - 1]);
+		frame++;
+	}
+	hk_tx_data[frame][3] = count;
+	hk_tx_data[frame][2] = hk_report_count;
+	pec = fletcher16_final(&f);
+	hk_tx_data[frame][1] = (uint8_t)(pec >> 8);
+	hk_tx_data[frame][0] = (uint8_t)pec;
+	hk_tx.report = hk_report_count++;
+	hk_tx.frames = frame + 1;
+	hk_arq_transmit((uint16_t)((1UL << hk_tx.frames) - 1));
+#else
+	send_arr[7] = (SELF_ID << 4)|HK_TASK_ID;
+	send_arr[6] = MT_HK;
+	send_arr[5] = HK_SINGLE;
+	send_arr[3] = 0;
+	send_arr[2] = 0;
+	for(i = 0; i < count; i++)
+	{
+		send_arr[4] = names[i];
+		send_arr[1] = (uint8_t)(values[i] >> 8);
+		send_arr[0] = (uint8_t)values[i];
+		can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
+		if(hk_pacing_ms)
+			delay_ms(hk_pacing_ms);
+	}
+#endif
+
+	return;
+}
+
+/************************************************************************/
+/* SEND CAN HEALTH                                                      */
+/*																		*/
+/* Sends the statistics kept by can_health.c to the OBC as a series of	*/
+/* HK_CAN_HEALTH frames, byte 4 holds the frame sequence:				*/
+/*	0: [3] CANTEC, [2] CANREC, [1] # error-passive, [0] # bus-off		*/
+/*	1: [3] state (bit 1 = bus-off, bit 0 = error-passive),				*/
+/*	   [2] highest CANTEC, [1:0] bus utilisation (per-mille)			*/
+/*	2: general errors [3] STUFF, [2] CRC, [1] FORM, [0] ACK				*/
+/*	3 + n: errors on MOb n, same layout as frame 2.						*/
+/*	9 + c: transmit class c (urgent, command, bulk), [3] most frames	*/
+/*	   queued, [2] mean and [1:0] longest queueing delay (64 us units,	*/
+/*	   0 without CAN_LATENCY_STATS)										*/
+/*	12: [3:2] HK frames sent again, [1:0] HK frames lost (hk_arq.c)		*/
+/*	13: mission clock, [3:2] last offset (us), [1:0] drift (ppm)		*/
+/*	14: [3] synced, [2] missed TIME_FUPs, [1:0] syncs (time_sync.c)		*/
+/*	15: [3] bit rate profile, [2] failed switches, [1:0] kbit/s			*/
+/************************************************************************/
+
+void send_can_health(uint8_t* command)
+{
+	uint8_t i, frame, mob, class;
+#if (CAN_LATENCY_STATS)
+	uint32_t mean;
+#endif
+	
+	send_arr[7] = (SELF_ID << 4)|HK_TASK_ID;
+	send_arr[6] = MT_HK;
+	send_arr[5] = HK_CAN_HEALTH;
+	
+	for (frame = 0; frame < (7 + CAN_NB_MOB + CAN_TX_CLASSES); frame++)
+	{
+		send_arr[4] = frame;
+		switch(frame)
+		{
+			case	0:
+				send_arr[3] = CANTEC;
+				send_arr[2] = CANREC;
+				send_arr[1] = can_errp_count;
+				send_arr[0] = can_boff_count;
+				break;
+			case	1:
+				send_arr[3] = (can_bus_off << 1)|can_errp;
+				send_arr[2] = can_tec_max;
+				send_arr[1] = (uint8_t)(can_util >> 8);
+				send_arr[0] = (uint8_t)can_util;
+				break;
+			default:								// Frames 2 to 11, MOb errors then transmit classes.
+				if(frame < (3 + CAN_NB_MOB))
+				{
+					mob = frame - 3;
+					for (i = 0; i < CAN_ERR_TYPES; i++)		// send_arr[i] = counter for CANSTMOB/CANGIT bit i.
+					{
+						if(frame == 2)
+							send_arr[i] = can_gen_errors[i];
+						else
+							send_arr[i] = can_mob_errors[mob][i];
+					}
+				}
+				else
+				{
+					class = frame - (3 + CAN_NB_MOB);
+					send_arr[3] = can_tx_high_water[class];
+#if (CAN_LATENCY_STATS)
+					mean = 0;
+					if(can_tx_sent[class])
+						mean = can_tx_wait_sum[class] / can_tx_sent[class];
+					if(mean > 0xFF)
+						mean = 0xFF;
+					send_arr[2] = (uint8_t)mean;
+					send_arr[1] = (uint8_t)(can_tx_wait_max[class] >> 8);
+					send_arr[0] = (uint8_t)can_tx_wait_max[class];
+#else
+					send_arr[2] = 0;			// Queueing delays are not kept.
+					send_arr[1] = 0;
+					send_arr[0] = 0;
+#endif
+				}
+				break;
+			case	(3 + CAN_NB_MOB + CAN_TX_CLASSES):
+				send_arr[3] = (uint8_t)(hk_retransmitted >> 8);
+				send_arr[2] = (uint8_t)hk_retransmitted;
+				send_arr[1] = (uint8_t)(hk_lost >> 8);
+				send_arr[0] = (uint8_t)hk_lost;
+				break;
+			case	(4 + CAN_NB_MOB + CAN_TX_CLASSES):
+				send_arr[3] = (uint8_t)((uint16_t)mclock.offset_us >> 8);
+				send_arr[2] = (uint8_t)mclock.offset_us;
+				send_arr[1] = (uint8_t)((uint16_t)mclock.drift_ppm >> 8);
+				send_arr[0] = (uint8_t)mclock.drift_ppm;
+				break;
+			case	(5 + CAN_NB_MOB + CAN_TX_CLASSES):
+				send_arr[3] = mclock.state;
+				send_arr[2] = mclock.missed;
+				send_arr[1] = (uint8_t)(mclock.syncs >> 8);
+				send_arr[0] = (uint8_t)mclock.syncs;
+				break;
+			case	(6 + CAN_NB_MOB + CAN_TX_CLASSES):
+				send_arr[3] = can_rate;
+				send_arr[2] = can_rate_fallbacks;
+				send_arr[1] = (uint8_t)(can_rate_kbit() >> 8);
+				send_arr[0] = (uint8_t)can_rate_kbit();
+				break;
+		}
+		can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
+		if(hk_pacing_ms)
+			delay_ms(hk_pacing_ms);
+	}
+	return;
+}
+
+#if (CAN_LATENCY_STATS)
+/************************************************************************/
+/* SEND COMMAND LATENCY                                                 */
+/*																		*/
+/* Sends the command service latency (frame timestamp -> end of the		*/
+/* handler) to the OBC as HK_CMD_LATENCY frames and then starts over.	*/
+/* Times are in units of 64 us. Byte 4 holds the frame sequence:		*/
+/*	0: [3:2] longest wait in the receive ring, [1:0] # late frames		*/
+/*	1 + 2n: [3] command SMALL-TYPE, [2] count, [1:0] mean				*/
+/*	2 + 2n: [3:2] min, [1:0] max										*/
+/************************************************************************/
+
+void send_cmd_latency(uint8_t* command)
+{
+	uint8_t i, frame = 0;
+	uint16_t mean;
+	uint32_t age;
+	
+	send_arr[7] = (SELF_ID << 4)|HK_TASK_ID;
+	send_arr[6] = MT_HK;
+	send_arr[5] = HK_CMD_LATENCY;
+	
+	age = can_rx_age_max >> CMD_LAT_SHIFT;
+	if(age > 0xFFFF)
+		age = 0xFFFF;
+	send_arr[4] = frame++;
+	send_arr[3] = (uint8_t)(age >> 8);
+	send_arr[2] = (uint8_t)age;
+	send_arr[1] = (uint8_t)(can_rx_late >> 8);
+	send_arr[0] = (uint8_t)can_rx_late;
 	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
+	
+	for (i = 0; i < CMD_LAT_SLOTS; i++)
+	{
+		if(!cmd_lat[i].type || !cmd_lat[i].count)
+			continue;
+		mean = (uint16_t)(cmd_lat[i].sum / cmd_lat[i].count);
+		send_arr[4] = frame++;
+		send_arr[3] = cmd_lat[i].type;
+		send_arr[2] = (cmd_lat[i].count > 0xFF) ? 0xFF : (uint8_t)cmd_lat[i].count;
+		send_arr[1] = (uint8_t)(mean >> 8);
+		send_arr[0] = (uint8_t)mean;
+		can_send_message(&(send_arr[0]), CAN1_MB6);
+		send_arr[4] = frame++;
+		send_arr[3] = (uint8_t)(cmd_lat[i].min >> 8);
+		send_arr[2] = (uint8_t)cmd_lat[i].min;
+		send_arr[1] = (uint8_t)(cmd_lat[i].max >> 8);
+		send_arr[0] = (uint8_t)cmd_lat[i].max;
+		can_send_message(&(send_arr[0]), CAN1_MB6);
+		if(hk_pacing_ms)
+			delay_ms(hk_pacing_ms);
+	}
+	
+	for (i = 0; i < CMD_LAT_SLOTS; i++)
+	{
+		cmd_lat[i].type = 0;
+	}
+	can_rx_age_max = 0;
+	can_rx_late = 0;
+	return;
+}
 #endif
 
-	send_hk = 0;
+#if (SELF_ID == 0)
+/************************************************************************/
+/* SEND RF LINK                                                         */
+/*																		*/
+/* Sends the UHF link statistics (rf_link_record()) to the OBC as		*/
+/* HK_RF_LINK frames and starts a new min / max period. Byte 4 holds	*/
+/* the frame sequence:													*/
+/*	0: [3:2] packets received, [1:0] packets flushed by the CC1120		*/
+/*	1: [3] calibration reasons so far (CAL_...), [2] calibrations,		*/
+/*	   [1:0] resets because the registers could not be repaired			*/
+/*	2 + 2n: [3:2] last, [1:0] average									*/
+/*	3 + 2n: [3:2] min, [1:0] max (min > max: nothing received)			*/
+/* with n = 0 RSSI (dBm), 1 LQI, 2 frequency offset estimate.			*/
+/************************************************************************/
+
+void send_rf_link(uint8_t* command)
+{
+	uint8_t i, frame = 0;
+	int16_t avg;
+	rf_stat* stats[3] = {&rf_rssi, &rf_lqi, &rf_freqoff};
+	
+	send_arr[7] = (SELF_ID << 4)|HK_TASK_ID;
+	send_arr[6] = MT_HK;
+	send_arr[5] = HK_RF_LINK;
+	
+	send_arr[4] = frame++;
+	send_arr[3] = (uint8_t)(rf_frames >> 8);
+	send_arr[2] = (uint8_t)rf_frames;
+	send_arr[1] = (uint8_t)(rf_rejected >> 8);
+	send_arr[0] = (uint8_t)rf_rejected;
+	can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
+	send_arr[4] = frame++;
+	send_arr[3] = uhf_cal_reasons;
+	send_arr[2] = (uhf_cals > 0xFF) ? 0xFF : (uint8_t)uhf_cals;
+	send_arr[1] = (uint8_t)(uhf_reinits >> 8);
+	send_arr[0] = (uint8_t)uhf_reinits;
+	can_send_message(&(send_arr[0]), CAN1_MB6);
+	
+	for (i = 0; i < 3; i++)
+	{
+		avg = (int16_t)(stats[i]->avg8 >> 3);
+		send_arr[4] = frame++;
+		send_arr[3] = (uint8_t)((uint16_t)stats[i]->last >> 8);
+		send_arr[2] = (uint8_t)stats[i]->last;
+		send_arr[1] = (uint8_t)((uint16_t)avg >> 8);
+		send_arr[0] = (uint8_t)avg;
+		can_send_message(&(send_arr[0]), CAN1_MB6);
+		send_arr[4] = frame++;
+		send_arr[3] = (uint8_t)((uint16_t)stats[i]->min >> 8);
+		send_arr[2] = (uint8_t)stats[i]->min;
+		send_arr[1] = (uint8_t)((uint16_t)stats[i]->max >> 8);
+		send_arr[0] = (uint8_t)stats[i]->max;
+		can_send_message(&(send_arr[0]), CAN1_MB6);
+		if(hk_pacing_ms)
+			delay_ms(hk_pacing_ms);
+	}
+	rf_link_reset();
 	return;
 }
+#endif
 
 /************************************************************************/
 /* SEND SENSOR DATA                                                     */
@@ -376,12 +526,12 @@ void send_housekeeping(void)
 /* this command upon request from the OBC.								*/
 /************************************************************************/
 
-void send_sensor_data(void)
+void send_sensor_data(uint8_t* command)
 {
 	uint8_t high, low, sensor_name, req_by;			
-	sensor_name = data_req_arr[4];
+	sensor_name = command[4];
 	uint32_t* temp_raw = malloc(sizeof(uint32_t));
-	req_by = data_req_arr[7] >> 4;
+	req_by = command[7] >> 4;
 	send_arr[3] = 0;
 	send_arr[2] = 0;
 	send_arr[1] = 0;
@@ -393,9 +543,34 @@ void send_sensor_data(void)
 #if (SELF_ID == 0)
 		case	COMS_TEMP:
 			temp = spi_retrieve_temp(COMS_TEMP_SS);
+			coms_temp = temp;
 			send_arr[1] = (uint8_t)(temp >> 8);			// SPI temperature sensor readings.
 			send_arr[0] = (uint8_t)(temp);
 			break;
+		case	COMS_RSSI:								// [3:2] last packet, [1:0] average.
+			send_arr[3] = (uint8_t)((uint16_t)rf_rssi.last >> 8);
+			send_arr[2] = (uint8_t)rf_rssi.last;
+			send_arr[1] = (uint8_t)(rf_rssi.avg8 >> 11);
+			send_arr[0] = (uint8_t)(rf_rssi.avg8 >> 3);
+			break;
+		case	COMS_LQI:
+			send_arr[3] = (uint8_t)((uint16_t)rf_lqi.last >> 8);
+			send_arr[2] = (uint8_t)rf_lqi.last;
+			send_arr[1] = (uint8_t)(rf_lqi.avg8 >> 11);
+			send_arr[0] = (uint8_t)(rf_lqi.avg8 >> 3);
+			break;
+		case	COMS_FREQOFF:
+			send_arr[3] = (uint8_t)((uint16_t)rf_freqoff.last >> 8);
+			send_arr[2] = (uint8_t)rf_freqoff.last;
+			send_arr[1] = (uint8_t)(rf_freqoff.avg8 >> 11);
+			send_arr[0] = (uint8_t)(rf_freqoff.avg8 >> 3);
+			break;
+		case	COMS_RF_REJECTED:						// [3:2] packets received, [1:0] packets flushed.
+			send_arr[3] = (uint8_t)(rf_frames >> 8);
+			send_arr[2] = (uint8_t)rf_frames;
+			send_arr[1] = (uint8_t)(rf_rejected >> 8);
+			send_arr[0] = (uint8_t)rf_rejected;
+			break;
 #endif
 #if (SELF_ID == 1)
 		case	EPS_TEMP:
@@ -525,7 +700,6 @@ void send_sensor_data(void)
 	send_arr[4] = CURRENT_MINUTE;			
 			
 	can_send_message(&(send_arr[0]), CAN1_MB0);		//CAN1_MB0 is the data reception MB.
-	send_data = 0;
 	
 	return;
 }
@@ -556,18 +730,18 @@ void send_coms_packet(void)
 /* SEND READ RESPONSE                                                   */
 /*																		*/
 /* Whent the OBC requests to read an address in the SSM's memory, this	*/
-/* function carries out that task with the use of global array read_arr	*/
-/* read_arr stores the most read request from the OBC.					*/
+/* function carries out that task. command[] is the read request from	*/
+/* the OBC.																*/
 /************************************************************************/
 
-void send_read_response(void)
+void send_read_response(uint8_t* command)
 {
 	uint8_t read_val, passkey, req_by;
 	uint8_t* read_ptr;
 	
-	passkey = read_arr[3];
-	read_ptr = read_arr[0];
-	req_by = read_arr[7];	// Used to coordinating with tasks on the OBC.
+	passkey = command[3];
+	read_ptr = command[0];
+	req_by = command[7] >> 4;	// Used to coordinating with tasks on the OBC.
 	
 	/*	Execute the read	*/
 	read_val = *read_ptr;
@@ -580,7 +754,6 @@ void send_read_response(void)
 	send_arr[0] = read_val;
 	
 	can_send_message(&(send_arr[0]), CAN1_MB7);
-	read_response = 0;
 	return;
 }
 
@@ -588,19 +761,18 @@ void send_read_response(void)
 /* SEND WRITE RESPONSE                                                  */
 /*																		*/
 /* When the OBC requests to write to an address in the SSM's memory,	*/
-/* this function carries out that task with global array write_arr.		*/
-/* write_arr stores the most recent write request. -1 is given to the	*/
-/* OBC as FAILURE, and 1 is returned as SUCCESS.						*/
+/* this function carries out that task. command[] is the write request.	*/
+/* -1 is given to the OBC as FAILURE, and 1 is returned as SUCCESS.		*/
 /************************************************************************/
-void send_write_response(void)
+void send_write_response(uint8_t* command)
 {
 	uint8_t passkey, write_data, ret_val, verify, req_by;
 	uint8_t* write_ptr;
 	
-	passkey = write_arr[3];
-	write_ptr = write_arr[1];
-	write_data = write_arr[0];
-	req_by = read_arr[7];	// Used to coordinating with tasks on the OBC.
+	passkey = command[3];
+	write_ptr = command[1];
+	write_data = command[0];
+	req_by = command[7] >> 4;	// Used to coordinating with tasks on the OBC.
 	
 	/*	Execute the Write	*/
 	*write_ptr = write_data;
@@ -620,257 +792,266 @@ void send_write_response(void)
 	send_arr[0] = ret_val;
 	
 	can_send_message(&(send_arr[0]), CAN1_MB7);
-	write_response = 0;
 	return;	
 }
 
 
-void set_sensor_high(void)
+void set_sensor_high(uint8_t* command)
 {
 	uint8_t sensor_name, req_by;
 	uint16_t high = 0;
-	sensor_name = sensh_arr[3];
-	req_by = sensh_arr[7] >> 4;
+	sensor_name = command[3];
+	req_by = command[7] >> 4;
 	
 #if (SELF_ID == 1)
 	if(sensor_name == EPS_TEMP)
 	{
-		epstemp_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		epstemp_high = command[0];
+		high = (uint16_t)command[1];
 		epstemp_high |= (high << 8);
 	}
 	if(sensor_name == PANELX_V)
 	{
-		pxv_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		pxv_high = command[0];
+		high = (uint16_t)command[1];
 		pxv_high |= (high << 8);		
 	}
 	if(sensor_name == PANELX_I)
 	{
-		pxi_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		pxi_high = command[0];
+		high = (uint16_t)command[1];
 		pxi_high |= (high << 8);
 	}
 	if(sensor_name == PANELY_V)
 	{
-		pyv_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		pyv_high = command[0];
+		high = (uint16_t)command[1];
 		pyv_high |= (high << 8);
 	}
 	if(sensor_name == PANELY_I)
 	{
-		pyi_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		pyi_high = command[0];
+		high = (uint16_t)command[1];
 		pyi_high |= (high << 8);
 	}
 	if(sensor_name == BATTM_V)
 	{
-		battmv_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		battmv_high = command[0];
+		high = (uint16_t)command[1];
 		battmv_high |= (high << 8);
 	}
 	if(sensor_name == BATT_V)
 	{
-		battv_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		battv_high = command[0];
+		high = (uint16_t)command[1];
 		battv_high |= (high << 8);
 	}
 	if(sensor_name == BATTIN_I)
 	{
-		pxv_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		pxv_high = command[0];
+		high = (uint16_t)command[1];
 		pxv_high |= (high << 8);
 	}
 	if(sensor_name == BATTOUT_I)
 	{
-		pxv_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		pxv_high = command[0];
+		high = (uint16_t)command[1];
 		pxv_high |= (high << 8);
 	}
 	if(sensor_name == COMS_V)
 	{
-		comsv_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		comsv_high = command[0];
+		high = (uint16_t)command[1];
 		comsv_high |= (high << 8);
 	}
 	if(sensor_name == COMS_I)
 	{
-		comsi_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		comsi_high = command[0];
+		high = (uint16_t)command[1];
 		comsi_high |= (high << 8);
 	}
 	if(sensor_name == PAY_V)
 	{
-		payv_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		payv_high = command[0];
+		high = (uint16_t)command[1];
 		payv_high |= (high << 8);
 	}
 	if(sensor_name == PAY_I)
 	{
-		payi_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		payi_high = command[0];
+		high = (uint16_t)command[1];
 		payi_high |= (high << 8);
 	}
 	if(sensor_name == OBC_V)
 	{
-		obcv_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		obcv_high = command[0];
+		high = (uint16_t)command[1];
 		obcv_high |= (high << 8);
 	}
 	if(sensor_name == OBC_I)
 	{
-		obci_high = sensh_arr[0];
-		high = (uint16_t)sensh_arr[1];
+		obci_high = command[0];
+		high = (uint16_t)command[1];
 		obci_high |= (high << 8);
 	}
 #endif
 	
-	set_sens_h = 0;
 	return;
 }
 
-void set_sensor_low(void)
+void set_sensor_low(uint8_t* command)
 {
 	uint8_t sensor_name, req_by;
 	uint16_t low = 0;
-	sensor_name = sensl_arr[3];
-	req_by = sensl_arr[7] >> 4;
+	sensor_name = command[3];
+	req_by = command[7] >> 4;
 	
 #if (SELF_ID == 1)
 	if(sensor_name == EPS_TEMP)
 	{
-		epstemp_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		epstemp_low = command[0];
+		low = (uint16_t)command[1];
 		epstemp_low |= (low << 8);
 	}
 	if(sensor_name == PANELX_V)
 	{
-		pxv_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		pxv_low = command[0];
+		low = (uint16_t)command[1];
 		pxv_low |= (low << 8);
 	}
 	if(sensor_name == PANELX_I)
 	{
-		pxi_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		pxi_low = command[0];
+		low = (uint16_t)command[1];
 		pxi_low |= (low << 8);
 	}
 	if(sensor_name == PANELY_V)
 	{
-		pyv_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		pyv_low = command[0];
+		low = (uint16_t)command[1];
 		pyv_low |= (low << 8);
 	}
 	if(sensor_name == PANELY_I)
 	{
-		pyi_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		pyi_low = command[0];
+		low = (uint16_t)command[1];
 		pyi_low |= (low << 8);
 	}
 	if(sensor_name == BATTM_V)
 	{
-		battmv_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		battmv_low = command[0];
+		low = (uint16_t)command[1];
 		battmv_low |= (low << 8);
 	}
 	if(sensor_name == BATT_V)
 	{
-		battv_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		battv_low = command[0];
+		low = (uint16_t)command[1];
 		battv_low |= (low << 8);
 	}
 	if(sensor_name == BATTIN_I)
 	{
-		battin_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		battin_low = command[0];
+		low = (uint16_t)command[1];
 		battin_low |= (low << 8);
 	}
 	if(sensor_name == BATTOUT_I)
 	{
-		battout_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		battout_low = command[0];
+		low = (uint16_t)command[1];
 		battout_low |= (low << 8);
 	}
 	if(sensor_name == COMS_V)
 	{
-		comsv_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		comsv_low = command[0];
+		low = (uint16_t)command[1];
 		comsv_low |= (low << 8);
 	}
 	if(sensor_name == COMS_I)
 	{
-		comsi_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		comsi_low = command[0];
+		low = (uint16_t)command[1];
 		comsi_low |= (low << 8);
 	}
 	if(sensor_name == PAY_V)
 	{
-		payv_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		payv_low = command[0];
+		low = (uint16_t)command[1];
 		payv_low |= (low << 8);
 	}
 	if(sensor_name == PAY_I)
 	{
-		payi_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		payi_low = command[0];
+		low = (uint16_t)command[1];
 		payi_low |= (low << 8);
 	}
 	if(sensor_name == OBC_V)
 	{
-		obcv_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		obcv_low = command[0];
+		low = (uint16_t)command[1];
 		obcv_low |= (low << 8);
 	}
 	if(sensor_name == OBC_I)
 	{
-		obci_low = sensl_arr[0];
-		low = (uint16_t)sensl_arr[1];
+		obci_low = command[0];
+		low = (uint16_t)command[1];
 		obci_low |= (low << 8);
 	}
 #endif
 	
-	set_sens_l = 0;
 	return;
 }
 
-void set_var(void)
+void set_var(uint8_t* command)
 {
 	uint8_t var_name, incom_val;
-	var_name = setv_arr[3];
-	incom_val = setv_arr[0];
+	var_name = command[3];
+	incom_val = command[0];
 	
 	switch(var_name)
 	{
+		case HK_PACING:
+			hk_pacing_ms = incom_val;
+			break;
 #if (SELF_ID == 0)
 		case SSM_CTT:
 			ssm_consec_trans_timeout = incom_val;
+			break;
 		case SSM_OGT:
 			ssm_ok_go_timeout = (uint32_t)incom_val;
+			break;
 		case COMS_FDIR_SIGNAL:
 			ssm_fdir_signal = incom_val;
+			break;
 #endif
 #if (SELF_ID == 1)
 		case MPPTX:
 			mpptx = incom_val;
+			break;
 		case MPPTY:
 			mppty = incom_val;
+			break;
 		case BALANCE_H:
 			balance_h = incom_val;
+			break;
 		case BALANCE_L:
 			balance_l = incom_val;
+			break;
 		case EPS_FDIR_SIGNAL:
 			ssm_fdir_signal = incom_val;
+			break;
 		case BATT_HEAT:
 			batt_heater_control = incom_val;
+			break;
 #endif
 #if (SELF_ID == 2)	
 		case PAY_FDIR_SIGNAL:
 			ssm_fdir_signal = incom_val;
+			break;
 #endif
 		default:
 			break;
 	}
-	set_varf = 0;
 	return;
 }
 
@@ -901,12 +1082,11 @@ static void clear_current_tm(void)
 	return;
 }
 
-void receive_tm_msg(void)
+void receive_tm_msg(uint8_t* command)
 {
 	uint8_t req_by, obc_seq_count;
-	req_by = new_tm_msg[7] >> 4;
-	obc_seq_count = new_tm_msg[4];
-	new_tm_msgf = 0;
+	req_by = command[7] >> 4;
+	obc_seq_count = command[4];
 	
 	if(obc_seq_count > (tm_sequence_count + 1))
 	{
@@ -928,19 +1108,18 @@ void receive_tm_msg(void)
 	{
 		tm_sequence_count = obc_seq_count;
 		receiving_tmf = 1;
-		current_tm[(obc_seq_count * 4)]		= new_tm_msg[0];
-		current_tm[(obc_seq_count * 4) + 1] = new_tm_msg[1];
-		current_tm[(obc_seq_count * 4) + 2] = new_tm_msg[2];
-		current_tm[(obc_seq_count * 4) + 3] = new_tm_msg[3];
+		current_tm[(obc_seq_count * 4)]		= command[0];
+		current_tm[(obc_seq_count * 4) + 1] = command[1];
+		current_tm[(obc_seq_count * 4) + 2] = command[2];
+		current_tm[(obc_seq_count * 4) + 3] = command[3];
 		if(obc_seq_count == PACKET_LENGTH / 4 - 1)
 		{
 			//PIN_toggle(LED2);
 			tm_sequence_count = 0;									// Reset tm_sequence_count, transmission has completed.
 			receiving_tmf = 0;
 			current_tm_fullf = 1;									// TM buffer now full, ready to downlink to ground.
-			store_current_tm();										// Put current_tm[] into tm_to_downlink[]
+			store_current_tm();										// Put current_tm[] into the downlink window.
 			send_tm_transaction_response(req_by, obc_seq_count);	// Let the OBC know that the transaction succeeded.
-			transmit_packet();
 		}
 		return;
 	}
@@ -971,13 +1150,11 @@ void alert_obc_tcp_ready(void)
 }
 
 // This function is necessary so that we can simply trash current_tm if a new transaction fails.
-static void store_current_tm(void)
+// current_tm_fullf stays set until the downlink window has room for current_tm[].
+void store_current_tm(void)
 {
-	uint8_t i;
-	for (i = 0; i < PACKET_LENGTH; i++)
-	{
-		tm_to_downlink[i] = current_tm[i];
-	}
+	if(!dl_enqueue(current_tm))
+		current_tm_fullf = 0;
 	return;
 }
 
@@ -1099,10 +1276,11 @@ void alert_deploy(void)
 	return;
 }
 
-void enter_take_over(void)
+void enter_take_over(uint8_t* command)
 {
+	if(TAKEOVER)
+		return;
 	TAKEOVER = 1;
-	enter_take_overf = 0;
 	send_arr[7] = (SELF_ID << 4)|OBC_ID;
 	send_arr[6] = MT_COM;
 	send_arr[5] = COMS_TAKEOVER_ENTERED;
@@ -1111,10 +1289,11 @@ void enter_take_over(void)
 	return;
 }
 
-void exit_take_over(void)
+void exit_take_over(uint8_t* command)
 {
+	if(!TAKEOVER)
+		return;
 	TAKEOVER = 0;
-	exit_take_overf = 0;
 	send_arr[7] = (SELF_ID << 4)|OBC_ID;
 	send_arr[6] = MT_COM;
 	send_arr[5] = COMS_TAKEOVER_EXITED;
@@ -1141,10 +1320,11 @@ void send_event(void)
 }
 
 #if (SELF_ID == 1)
-void enter_low_power(void)
+void enter_low_power(uint8_t* command)
 {
+	if(LOW_POWER_MODE)
+		return;
 	// Sam: Fill this in with what needs to be done for low power mode.
-	enter_low_powerf = 0;
 	LOW_POWER_MODE = 1;
 	send_arr[7] = (SELF_ID << 4)|OBC_ID;
 	send_arr[6] = MT_COM;
@@ -1154,11 +1334,12 @@ void enter_low_power(void)
 	return;
 }
 
-void exit_low_power(void)
+void exit_low_power(uint8_t* command)
 {	
+	if(!LOW_POWER_MODE)
+		return;
 	// Sam: Fill this in with what needs to be done to exit low power mode.
 	LOW_POWER_MODE = 0;
-	exit_low_powerf = 0;
 	send_arr[7] = (SELF_ID << 4)|OBC_ID;
 	send_arr[6] = MT_COM;
 	send_arr[5] = LOW_POWER_MODE_EXITED;
@@ -1171,28 +1352,25 @@ void exit_low_power(void)
 // At the moment we hard-wired the antenna deployer to the EPS board and
 // so the command to deploy the antenna goes to the OPR where it is then
 // redirected to the EPS SSM.
-void deploy_antenna(void)
+void deploy_antenna(uint8_t* command)
 {
 	PIN_set(LED3);	// Replace with code to deploy antenna.
 	PIN_set(ANT_DEP_PIN);
 	antenna_deployed = 1;
-	deploy_antennaf = 0;
 	return;
 }
 
-void turn_off_deploy(void)
+void turn_off_deploy(uint8_t* command)
 {
 	PIN_clr(LED3);	// Replace with code to turn off the antenna deployment.
 	PIN_clr(ANT_DEP_PIN);
-	turn_off_deployf = 0;
 	return;
 }
 #endif		// EPS COMMAND SECTION ABOVE ^^
 
-void pause_operations(void)
+void pause_operations(uint8_t* command)
 {
 	PAUSE = 1;
-	pause_operationsf = 0;
 	send_arr[7] = (SELF_ID << 4)|OBC_ID;
 	send_arr[6] = MT_COM;
 	send_arr[5] = OPERATIONS_PAUSED;
@@ -1201,10 +1379,9 @@ void pause_operations(void)
 	return;	
 }
 
-void resume_operations(void)
+void resume_operations(uint8_t* command)
 {
 	PAUSE = 0;
-	resume_operationsf = 0;
 	send_arr[7] = (SELF_ID << 4)|OBC_ID;
 	send_arr[6] = MT_COM;
 	send_arr[5] = OPERATIONS_RESUMED;
@@ -1214,16 +1391,14 @@ void resume_operations(void)
 }
 
 #if (SELF_ID == 2)
-void open_valves(void)
+void open_valves(uint8_t* command)
 {
-	open_valvesf = 0;
 	// Open valves here.
 	return;
 }
 
-void collect_pd(void)
+void collect_pd(uint8_t* command)
 {
-	collect_pdf = 0;
 	
 	// Implement the collection of photodiode data here.
 	
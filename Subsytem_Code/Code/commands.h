@@ -8,7 +8,7 @@
 	*
 	*	FILE REFERENCES:		can_api.h
 	*
-	*	EXTERNAL VARIABLES:		send_now, send_data, send_hk, send_coms
+	*	EXTERNAL VARIABLES:		cmd_queue, cmd_queue_count
 	*
 	*	EXTERNAL REFERENCES:	Same a File References.
 	*
@@ -26,6 +26,9 @@
 	*
 	*	08/08/2015		Added functions send_read_response() and send_write_response().
 	*
+	*	10/16/2026		Command functions now take the command message as a parameter so that
+	*					they can be called through command_table[] in can_api.c.
+	*
 */
 
 #ifndef COMMANDS_H
@@ -40,6 +43,7 @@
 	#include "trans_lib.h"
 #endif
 #include "error_handling.h"
+#include "checksum.h"
 #include <stdint.h>
 #include <stdlib.h>
 #include "spi_lib.h"
@@ -47,32 +51,39 @@
 
 /* Function Prototypes								 */	
 void run_commands(void);
-void send_response(void);
-void send_housekeeping(void);
-void send_sensor_data(void);
+void send_response(uint8_t* command);
+void send_housekeeping(uint8_t* command);
+void send_can_health(uint8_t* command);
+#if (CAN_LATENCY_STATS)
+void send_cmd_latency(uint8_t* command);
+#endif
+void send_rf_link(uint8_t* command);
+void send_sensor_data(uint8_t* command);
 void send_coms_packet(void);
-void send_read_response(void);
-void send_write_response(void);
-void set_sensor_high(void);
-void set_sensor_low(void);
-void set_var(void);
-void receive_tm_msg(void);
+void send_read_response(uint8_t* command);
+void send_write_response(uint8_t* command);
+void set_sensor_high(uint8_t* command);
+void set_sensor_low(uint8_t* command);
+void set_var(uint8_t* command);
+void receive_tm_msg(uint8_t* command);
 void alert_obc_tcp_ready(void);
 void send_pus_packet_tc(void);
+void store_current_tm(void);
 void send_event(void);
 void send_ask_alive(void);
-void enter_low_power(void);
-void exit_low_power(void);
-void enter_take_over(void);
-void exit_take_over(void);
-void open_valves(void);
-void collect_pd(void);
-void pause_operations(void);
-void resume_operations(void);
+void enter_low_power(uint8_t* command);
+void exit_low_power(uint8_t* command);
+void enter_take_over(uint8_t* command);
+void exit_take_over(uint8_t* command);
+void open_valves(uint8_t* command);
+void collect_pd(uint8_t* command);
+void pause_operations(uint8_t* command);
+void resume_operations(uint8_t* command);
 uint16_t collect_pressure(void);
 uint8_t convert_to_temp(uint32_t* temp);
 void alert_deploy(void);
-void deploy_antenna(void);
+void deploy_antenna(uint8_t* command);
+void turn_off_deploy(uint8_t* command);
 
 /*****************************************************/
 #endif
@@ -0,0 +1,239 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		dl_arq.c
+	*
+	*	PURPOSE:	This program takes care of getting TM packets down to the ground. Up to DL_WINDOW
+	*				frames are kept in dl_window[] and sent without waiting for each one to be
+	*				acknowledged. Frames which are not acknowledged are sent again.
+	*
+	*	FILE REFERENCES:	dl_arq.h
+	*
+	*	EXTERNAL VARIABLES:	dl_window, dl_head, dl_count, dl_packet_id, dl_srtt, dl_rto, dl_gap, dl_retransmits,
+	*						dl_acked, transmitting_sequence_control
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	dl_arq_transmit() is called by transceiver_run() when the
+	*											CC1120 is listening and dl_gap has passed since the
+	*											last transmission.
+	*
+	*	NOTES:	A frame is 79 bytes: [0] is the sequence number (low byte of
+	*			transmitting_sequence_control) and [78:1] is one fragment of the TM (frag.c).
+	*			A TM takes FRAG_COUNT consecutive frames.
+	*
+	*			The ground acknowledges with a 3-byte packet (ACK_LENGTH):
+	*
+	*				[0]		DL_ACK_TAG
+	*				[1]		cumulative, every frame before this sequence number was received
+	*				[2]		bit i set = frame ([1] + 1 + i) was received as well
+	*
+	*			A plain "ACK" from a ground station which doesn't know about the window acknowledges
+	*			the oldest frame which has been sent.
+	*
+	*			The round-trip time of frames acknowledged on their first transmission (dl_srtt) sets
+	*			the retransmission timeout (2 x RTT) and the gap between transmissions (RTT spread over
+	*			the window). A retransmission of the oldest frame doubles dl_rto, up to TRANSMIT_TIMEOUT.
+	*			Once it gets there no ground station is assumed to be listening and only the oldest
+	*			frame is sent, once every TRANSMIT_TIMEOUT, which is what COMS did before.
+	*
+	*			current_tm_fullf stays set (the OBC is held off) only while the window has no room for a TM.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026			Created.
+	*
+	*	10/17/2026			DL_WINDOW is now FRAG_COUNT (one TM in flight) to keep COMS within its 2 KB of RAM.
+	*
+*/
+
+#include "dl_arq.h"
+
+#if (SELF_ID == 0)
+
+static void dl_ack_frame(dl_frame* f);
+static void dl_rtt_sample(uint32_t sent);
+static void dl_set_timers(void);
+
+void dl_arq_init(void)
+{
+	dl_head = 0;
+	dl_count = 0;
+	dl_packet_id = 0;
+	dl_srtt = 0;
+	dl_rto = TRANSMIT_TIMEOUT;
+	dl_gap = DL_GAP_MIN;
+	dl_retransmits = 0;
+	dl_acked = 0;
+	return;
+}
+
+/************************************************************************/
+/* DL ENQUEUE                                                           */
+/*																		*/
+/* Splits tm into FRAG_COUNT fragments and puts each into the window	*/
+/* behind a new sequence number. Returns 0xFF if they don't all fit.	*/
+/************************************************************************/
+
+uint8_t dl_enqueue(uint8_t* tm)
+{
+	uint8_t i;
+	dl_frame* f;
+	
+	if(dl_count > (DL_WINDOW - FRAG_COUNT))
+		return 0xFF;
+	for(i = 0; i < FRAG_COUNT; i++)
+	{
+		f = &dl_window[(dl_head + dl_count) % DL_WINDOW];
+		f->data[0] = (uint8_t)transmitting_sequence_control++;
+		frag_build(f->data + 1, tm, dl_packet_id, i);
+		f->tries = 0;
+		f->acked = 0;
+		dl_count++;
+	}
+	dl_packet_id++;
+	return 0;
+}
+
+/************************************************************************/
+/* DL ARQ TRANSMIT                                                      */
+/*																		*/
+/* Sends the oldest frame which is either new or whose dl_rto has run	*/
+/* out. Returns 1 if a frame was sent.									*/
+/************************************************************************/
+
+uint8_t dl_arq_transmit(void)
+{
+	uint8_t i;
+	dl_frame* f = 0;
+	uint32_t now = millis();
+	
+	for(i = 0; i < dl_count; i++)
+	{
+		f = &dl_window[(dl_head + i) % DL_WINDOW];
+		if(f->acked)
+			continue;
+		if(!f->tries)
+			break;
+		if((now - f->sent) >= dl_rto)
+		{
+			if(!i)								// Back off once per round, on the oldest frame.
+			{
+				dl_rto <<= 1;
+				if(dl_rto > TRANSMIT_TIMEOUT)
+					dl_rto = TRANSMIT_TIMEOUT;
+			}
+			dl_retransmits++;
+			break;
+		}
+		if(dl_rto >= TRANSMIT_TIMEOUT)			// Nobody is listening, only probe with the oldest frame.
+			return 0;
+	}
+	if(i == dl_count)
+		return 0;
+	cmd_str(SIDLE);
+	cmd_str(SFRX);
+	transceiver_send(f->data, DEVICE_ADDRESS, DL_FRAME_LENGTH);
+	if(f->tries < 0xFF)
+		f->tries++;
+	f->sent = now;
+	return 1;
+}
+
+/************************************************************************/
+/* DL ACK RECEIVED                                                      */
+/*																		*/
+/* Called by the transceiver with the 3-byte payload of an				*/
+/* acknowledgment from the ground. Slides the window past the frames	*/
+/* which were received and lets the next TM in.							*/
+/************************************************************************/
+
+void dl_ack_received(uint8_t* ack)
+{
+	uint8_t i, n, pos;
+	dl_frame* f;
+	
+	if(!dl_count)
+		return;
+	if(ack[0] == DL_ACK_TAG)
+	{
+		n = ack[1] - dl_window[dl_head].data[0];		// Frames covered by the cumulative part.
+		if(n > dl_count)
+			n = 0;										// Old news.
+		for(i = 0; i < dl_count; i++)
+		{
+			f = &dl_window[(dl_head + i) % DL_WINDOW];
+			pos = f->data[0] - ack[1] - 1;
+			if((i < n) || ((pos < 8) && (ack[2] & (1 << pos))))
+				dl_ack_frame(f);
+		}
+	}
+	else
+	{
+		for(i = 0; i < dl_count; i++)
+		{
+			f = &dl_window[(dl_head + i) % DL_WINDOW];
+			if(f->tries && !f->acked)
+			{
+				dl_ack_frame(f);
+				break;
+			}
+		}
+	}
+	while(dl_count && dl_window[dl_head].acked)
+	{
+		dl_head = (dl_head + 1) % DL_WINDOW;
+		dl_count--;
+	}
+	if(current_tm_fullf)
+		store_current_tm();						// A TM was waiting for room.
+	return;
+}
+
+// Helper
+static void dl_ack_frame(dl_frame* f)
+{
+	if(!f->tries || f->acked)
+		return;									// Can't have been received yet.
+	f->acked = 1;
+	dl_acked++;
+	if(f->tries == 1)							// Karn: only unambiguous samples.
+		dl_rtt_sample(f->sent);
+	else if(dl_srtt)
+		dl_set_timers();						// The link is back, undo the back-off.
+	return;
+}
+
+// Helper: dl_srtt += (sample - dl_srtt) / 8.
+static void dl_rtt_sample(uint32_t sent)
+{
+	uint32_t sample = millis() - sent;
+	
+	if(sample > TRANSMIT_TIMEOUT)
+		sample = TRANSMIT_TIMEOUT;
+	if(!dl_srtt)
+		dl_srtt = (uint16_t)sample;
+	else
+		dl_srtt = dl_srtt - (dl_srtt >> 3) + ((uint16_t)sample >> 3);
+	dl_set_timers();
+	return;
+}
+
+// Helper: dl_rto = 2 x dl_srtt and dl_gap = dl_srtt / DL_WINDOW, within their limits.
+static void dl_set_timers(void)
+{
+	dl_rto = dl_srtt << 1;
+	if(dl_rto < DL_RTO_MIN)
+		dl_rto = DL_RTO_MIN;
+	if(dl_rto > TRANSMIT_TIMEOUT)
+		dl_rto = TRANSMIT_TIMEOUT;
+	dl_gap = dl_srtt / DL_WINDOW;
+	if(dl_gap < DL_GAP_MIN)
+		dl_gap = DL_GAP_MIN;
+	return;
+}
+
+#endif
@@ -0,0 +1,39 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		dl_arq.h
+	*
+	*	PURPOSE:	This program contains the prototypes for dl_arq.c
+	*
+	*	FILE REFERENCES:	trans_lib.h
+	*
+	*	EXTERNAL VARIABLES:	
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026			Created.
+	*
+*/
+
+#ifndef DL_ARQ_H
+#define DL_ARQ_H
+
+#include "trans_lib.h"
+
+#if (SELF_ID == 0)
+void dl_arq_init(void);
+uint8_t dl_enqueue(uint8_t* tm);
+uint8_t dl_arq_transmit(void);
+void dl_ack_received(uint8_t* ack);
+#endif
+
+#endif
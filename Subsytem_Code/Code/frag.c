@@ -0,0 +1,154 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		frag.c
+	*
+	*	PURPOSE:	This program splits 152-byte PUS packets into radio frames and puts them back
+	*				together on the other side.
+	*
+	*	FILE REFERENCES:	frag.h
+	*
+	*	EXTERNAL VARIABLES:	rx_frag_id, rx_frag_have, rx_frag_started, rx_frag_last, rx_frag_completed,
+	*						rx_frag_timeouts, rx_frag_duplicates
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	Only one packet is reassembled at a time. The caller
+	*											passes the same buffer for every fragment of it.
+	*
+	*	NOTES:	A fragment is FRAG_FRAME_LENGTH (78) bytes:
+	*
+	*				[0]		packet id, the same in every fragment of a packet
+	*				[1]		(index << 4) | FRAG_COUNT
+	*				[77:2]	packet bytes (76 x index) to (76 x index + 75)
+	*
+	*			So fragment 1 carries bytes 151-76, which is what used to be sent on its own.
+	*
+	*			Fragments may arrive in any order and more than once. A fragment of a different
+	*			packet, or one arriving more than FRAG_TIMEOUT after the first fragment, starts the
+	*			reassembly over. Fragments of the last packet completed are reported as duplicates
+	*			for FRAG_TIMEOUT after it completed, so that they can be acknowledged again without
+	*			storing the packet twice. After that the same id is a new packet (the ground may
+	*			start its ids over).
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026			Created.
+	*
+	*	10/17/2026			rx_frag_last expires FRAG_TIMEOUT after the packet completed. Until now a
+	*						new packet which reused its id was dropped as a duplicate for good.
+	*
+	*	10/17/2026			Added frag_check() so that store_new_packet() can look at a fragment before
+	*						making room for it.
+	*
+*/
+
+#include "frag.h"
+
+#if (SELF_ID == 0)
+
+void frag_init(void)
+{
+	rx_frag_id = 0;
+	rx_frag_have = 0;
+	rx_frag_started = 0;
+	rx_frag_last = FRAG_NONE;
+	rx_frag_completed = 0;
+	rx_frag_timeouts = 0;
+	rx_frag_duplicates = 0;
+	return;
+}
+
+/************************************************************************/
+/* FRAG BUILD                                                           */
+/*																		*/
+/* Writes fragment 'index' of packet into frame[].						*/
+/************************************************************************/
+
+void frag_build(uint8_t* frame, uint8_t* packet, uint8_t id, uint8_t index)
+{
+	uint8_t i;
+	uint8_t* data = packet + (uint8_t)(index * FRAG_DATA_LENGTH);
+	
+	frame[0] = id;
+	frame[1] = (index << 4) | FRAG_COUNT;
+	for(i = 0; i < FRAG_DATA_LENGTH; i++)
+	{
+		frame[i + FRAG_HEADER_LENGTH] = data[i];
+	}
+	return;
+}
+
+/************************************************************************/
+/* FRAG CHECK                                                           */
+/*																		*/
+/* Checks the header of the fragment in frame[] without storing it.		*/
+/* Returns FRAG_INVALID, FRAG_DUPLICATE for a fragment of the last		*/
+/* packet completed, or FRAG_INCOMPLETE if frag_receive() would take it.*/
+/************************************************************************/
+
+uint8_t frag_check(uint8_t* frame)
+{
+	uint8_t index = frame[1] >> 4;
+	
+	if(((frame[1] & 0x0F) != FRAG_COUNT) || (index >= FRAG_COUNT))
+		return FRAG_INVALID;
+	if((rx_frag_last != FRAG_NONE) && ((millis() - rx_frag_completed) > FRAG_TIMEOUT))
+		rx_frag_last = FRAG_NONE;				// Too old to be a retransmission.
+	if(frame[0] == rx_frag_last)
+	{
+		rx_frag_duplicates++;
+		return FRAG_DUPLICATE;
+	}
+	return FRAG_INCOMPLETE;
+}
+
+/************************************************************************/
+/* FRAG RECEIVE                                                         */
+/*																		*/
+/* Copies the fragment in frame[] to its place in packet[]. Returns		*/
+/* FRAG_COMPLETE once every fragment of the packet is in.				*/
+/************************************************************************/
+
+uint8_t frag_receive(uint8_t* frame, uint8_t* packet)
+{
+	uint8_t i, index, ret;
+	uint8_t* data;
+	
+	ret = frag_check(frame);
+	if(ret != FRAG_INCOMPLETE)
+		return ret;
+	index = frame[1] >> 4;
+	if(rx_frag_have && ((frame[0] != rx_frag_id) || ((millis() - rx_frag_started) > FRAG_TIMEOUT)))
+	{
+		rx_frag_timeouts++;						// Give up on the old packet.
+		rx_frag_have = 0;
+	}
+	if(!rx_frag_have)
+	{
+		rx_frag_id = frame[0];
+		rx_frag_started = millis();
+	}
+	if(rx_frag_have & (1 << index))
+	{
+		rx_frag_duplicates++;
+		return FRAG_DUPLICATE;
+	}
+	data = packet + (uint8_t)(index * FRAG_DATA_LENGTH);
+	for(i = 0; i < FRAG_DATA_LENGTH; i++)
+	{
+		data[i] = frame[i + FRAG_HEADER_LENGTH];
+	}
+	rx_frag_have |= (1 << index);
+	if(rx_frag_have != ((1 << FRAG_COUNT) - 1))
+		return FRAG_INCOMPLETE;
+	rx_frag_have = 0;
+	rx_frag_last = rx_frag_id;
+	rx_frag_completed = millis();
+	return FRAG_COMPLETE;
+}
+
+#endif
@@ -0,0 +1,47 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		frag.h
+	*
+	*	PURPOSE:	This program contains the prototypes for frag.c
+	*
+	*	FILE REFERENCES:	trans_lib.h
+	*
+	*	EXTERNAL VARIABLES:	
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026			Created.
+	*
+	*	10/17/2026			Added frag_check().
+	*
+*/
+
+#ifndef FRAG_H
+#define FRAG_H
+
+#include "trans_lib.h"
+
+/* frag_receive() return values */
+#define FRAG_INCOMPLETE		0		// Fragment stored, more to come.
+#define FRAG_COMPLETE		1		// That was the last missing fragment, the packet is whole.
+#define FRAG_DUPLICATE		2		// Already have it (our ACK was probably lost).
+#define FRAG_INVALID		0xFF
+
+#if (SELF_ID == 0)
+void frag_init(void);
+void frag_build(uint8_t* frame, uint8_t* packet, uint8_t id, uint8_t index);
+uint8_t frag_check(uint8_t* frame);
+uint8_t frag_receive(uint8_t* frame, uint8_t* packet);
+#endif
+
+#endif
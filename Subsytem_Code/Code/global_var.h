@@ -32,8 +32,150 @@ typedef struct{
 	uint8_t data[152];
 } packet;
 
+typedef struct{
+	uint16_t id;
+	uint8_t data[8];
+	uint16_t queued;	// can_time_us() >> CMD_LAT_SHIFT when the frame was queued.
+} can_frame;
+
+typedef void (*command_handler)(uint8_t* command);
+
+typedef struct{
+	command_handler handler;	// Called with the 8-byte command message.
+	uint8_t flags;				// CMD_IMMEDIATE, CMD_COALESCE.
+} command_entry;
+
+typedef struct{
+	uint8_t state;		// TP_IDLE, TP_WAIT_FC, TP_SENDING, TP_WAIT_ACK, TP_RECEIVING.
+	uint8_t peer;		// Task on the OBC at the other end of the transfer.
+	uint8_t length;		// Bytes in the packet.
+	uint8_t offset;		// Bytes sent / received so far.
+	uint8_t sn;			// Sequence number of the next consecutive frame (4 bits).
+	uint8_t bs;			// Block size, 0 = no further flow control.
+	uint8_t block_left;	// Consecutive frames left in the current block.
+	uint8_t stmin;		// Minimum separation time between consecutive frames (ms).
+	uint8_t retries;
+	uint32_t last;		// can_time_us() of the last frame sent / received.
+} tp_channel;
+
+typedef struct{
+	uint8_t type;		// COMMAND SMALL-TYPE, 0 = unused.
+	uint16_t count;
+	uint16_t min, max;	// In units of (1 << CMD_LAT_SHIFT) us.
+	uint32_t sum;
+} cmd_latency;
+
+typedef struct{
+	uint8_t state;			// TIME_UNSYNCED, TIME_SYNCED.
+	uint8_t fup_pending;	// A TIME_SYNC was received, waiting for its TIME_FUP.
+	uint8_t seq;			// Sequence number of the last TIME_SYNC.
+	uint32_t sync_local;	// can_time_us() at which the last TIME_SYNC was received.
+	uint32_t sync_sec;		// Mission seconds carried by the last TIME_SYNC.
+	uint32_t prev_local;	// sync_local and master time (us, wraps) of the previous sync,
+	uint32_t prev_master;	// used to measure the drift.
+	uint32_t base_local;	// can_time_us() at which the mission clock was base_ms + base_us.
+	uint32_t base_ms;
+	uint16_t base_us;		// 0 - 999
+	int16_t drift_ppm;		// How much faster the OBC clock runs than ours.
+	int16_t offset_us;		// Phase error found by the last sync (OBC - ours).
+	uint16_t syncs;			// Syncs completed.
+	uint8_t missed;			// TIME_SYNCs without a matching TIME_FUP.
+} mission_clock;
+
+typedef struct{
+	uint16_t kbit;
+	uint8_t bt1, bt2, bt3;	// CANBT1-3 for FOSC.
+} can_rate_profile;
 
-#define DATA_BUFFER_SIZE		8 // 8 bytes max
+typedef struct{
+	uint8_t mob;		// Receive MOb which holds the filter.
+	uint8_t id;			// A frame is accepted if (ID & mask) == (id & mask).
+	uint8_t mask;
+} can_filter;
+
+typedef struct{
+	uint8_t frames;		// Frames in the report (HK_PACKED_END included), 0 = nothing outstanding.
+	uint8_t report;		// Report count sent in the HK_PACKED_END frame.
+	uint16_t missing;	// Bit n is set until frame n has been acknowledged.
+	uint8_t retries;
+	uint32_t last;		// can_time_us() of the last (re)transmission.
+} hk_report;
+
+typedef struct{
+	uint8_t data[79];				// [0] = sequence number, [78:1] = one fragment of the TM.
+	uint8_t tries;					// Transmissions so far, 0 = not sent yet.
+	uint8_t acked;
+	uint32_t sent;					// millis() of the last transmission.
+} dl_frame;
+
+typedef struct{
+	int16_t last;
+	int16_t min, max;	// Since rf_link_reset().
+	int32_t avg8;		// Exponentially weighted average (weight 1/8), times 8.
+} rf_stat;
+
+typedef struct{
+	uint8_t flags;		// CC_EXT, CC_NO_VERIFY.
+	uint8_t addr;		// Register address, in the extended space if CC_EXT is set.
+	uint8_t value;
+} cc1120_reg;
+
+typedef struct{
+	uint16_t sum1;		// Running sums, only reduced mod 255 every FLETCHER_BLOCK bytes.
+	uint16_t sum2;
+	uint8_t left;		// Bytes until the next reduction.
+} fletcher_state;
+
+
+/*				CAN RECEIVE RING BUFFER						*/
+#define CAN_RX_RING_SIZE		8	// Must be a power of 2, each entry is one 8-byte frame.
+#define CAN_RX_BATCH			8	// Max frames decoded per call to can_check_general().
+#define CAN_RX_MOB_MASK			((1 << CAN_FILTER0_MOB)|(1 << CAN_FILTER1_MOB))	// One MOb per acceptance filter.
+
+/*				CAN TRANSMIT QUEUE							*/
+#define CAN_TX_CLASSES			3	// One queue per priority class, see MESSAGE PRIORITIES.
+#define CAN_TX_CLASS_SIZE		4	// Frames waiting in each class for a free transmit MOb.
+#define CAN_CLASS_URGENT		0	// Errors and alerts (priority >= URGENT_PRIO).
+#define CAN_CLASS_COMMAND		1	// Commands, responses and TP handshakes (>= COMMAND_PRIO).
+#define CAN_CLASS_BULK			2	// Housekeeping and data.
+#define CAN_TX_URGENT_MOB		0	// Only takes urgent frames. When several MObs are ready the lowest one is sent first.
+#define CAN_TX_MOB_MASK			((1 << CAN_TX_URGENT_MOB)|(1 << 4))	// MObs used for transmission (the 32M1 only has MOb0-5).
+#define CAN_TX_WAIT_US			100	// Poll interval of can_send_message() while the queue is full.
+#define CAN_TX_WAIT_TRIES		100	// ~10 ms before can_send_message() gives up on a full queue.
+#define CAN_ID_CLASS_BITS		0	// 1 = put the priority class in CAN ID bits 10-8. Only with OBC firmware
+									// which ignores those bits, otherwise every frame gets a new ID.
+
+/*				CAN HEALTH									*/
+#define CAN_NB_MOB				6	// MObs with error counters (same as NB_MOB in can_drv.h).
+#define CAN_ERR_TYPES			4	// ACK, FORM, CRC, STUFF (bit order of CANSTMOB and CANGIT).
+#define CAN_BOFF_MIN_POLLS		1	// Bus-off back-off, in calls to can_health_poll(). Doubled after each
+#define CAN_BOFF_MAX_POLLS		32	// bus-off up to CAN_BOFF_MAX_POLLS.
+#define CAN_BOFF_STABLE_POLLS	100	// Polls without a bus-off before the back-off drops to the minimum.
+#define CAN_UTIL_WINDOW_US		1000000	// Bus utilisation is averaged over at least this long.
+#define CAN_FRAME_BITS			125	// Approx. bits in an 8-byte standard frame (stuffing + IFS included).
+#define CAN_RX_LATE_US			50000	// A frame which waited longer than this before being decoded is "late".
+#define CMD_LAT_SLOTS			6	// Number of command types whose service latency is tracked.
+#define CMD_LAT_SHIFT			6	// Latencies are kept in units of 64 us (max ~4.2 s).
+#define CAN_LATENCY_STATS		(SELF_ID != 0)	// Command latency and transmit queueing delays (HK_CMD_LATENCY,
+												// HK_CAN_HEALTH 9-11). COMS needs that RAM for its UHF buffers.
+
+/*				CAN BIT RATE (can_rate.c)					*/
+#define CAN_RATE_PROFILES		3	// 0 = CAN_BAUDRATE (250 kbit), 1 = 500 kbit, 2 = 1 Mbit.
+#define CAN_RATE_DEFAULT		0	// Used at reset, after a bus-off and when a switch fails.
+#define CAN_RATE_STABLE			0
+#define CAN_RATE_SCHEDULED		1	// A CAN_RATE_SWITCH was received, waiting for its time.
+#define CAN_RATE_TRIAL			2	// Switched, waiting for the first good frame at the new rate.
+#define CAN_RATE_TRIAL_US		2000000	// No good frame within this long -> back to CAN_RATE_DEFAULT.
+#define CAN_RATE_TEST_FRAMES	32	// Default length of the CAN_RATE_TEST burst.
+#define CAN_RATE_TEST_US		200000	// Max wait for the burst to go out.
+
+/*				MISSION CLOCK (time_sync.c)					*/
+#define TIME_UNSYNCED			0	// Free running from reset.
+#define TIME_SYNCED				1
+#define TIME_FUP_TIMEOUT_US		100000	// Max gap between a TIME_SYNC and its TIME_FUP.
+#define TIME_SYNC_DELAY_US		0		// Both ends stamp the SYNC frame at the same point, nothing to add.
+#define TIME_REBASE_US			1000000	// The clock is rebased this often so the 32-bit us math cannot overflow.
+#define TIME_DRIFT_MAX_PPM		1000	// Drift measurements beyond this are ignored.
 
 /*				MY CAN DEFINES								*/
 #define SELF_ID					1 // Current SSM is EPS.
@@ -46,7 +188,64 @@ typedef struct{
 								 
 #define MPPT_ENABLE				0 // Note: if MPPT_ENABLE == 1, the other SSMs will not be programmable from the laptop interface.
 
+#define HK_PACKED				0 // Note: If HK_PACKED == 1, housekeeping is sent as a packed report (two values
+								  // per frame + a checksum frame). Only set it together with OBC firmware which
+								  // parses it, the current OBC expects one sensor per frame.
+
+#define HK_PACING_MS			0 // Default gap (ms) between HK frames, 0 = back-to-back. Can be changed with SET_VAR/HK_PACING.
+
+#define HK_MAX_VALUES			16 // Max number of 16-bit values in one housekeeping report.
+#define HK_MAX_FRAMES			(HK_MAX_VALUES / 2 + 1)	// Packed frames + HK_PACKED_END, at most 16.
+#define HK_ACK_TIMEOUT_US		200000	// Wait for an HK_ACK before the missing frames are sent again.
+#define HK_MAX_RETRIES			3		// Retransmissions before the missing frames are counted as lost.
+
+#define PUS_SEGMENTED			0 // Note: If PUS_SEGMENTED == 1, PUS TM/TC packets are moved with the segmented
+								  // transfer in pus_tp.c (6 bytes per frame). Only set it together with OBC
+								  // firmware which speaks it, the current OBC uses SEND_TM / SEND_TC (4 bytes per frame).
+
+#define CMD_QUEUE_SIZE			8 // Max number of commands waiting for run_commands().
+#define CMD_IMMEDIATE			0x01 // Run from decode_command() instead of run_commands().
+#define CMD_COALESCE			0x02 // A repeat of a pending command replaces it instead of queuing again.
+
 #define PACKET_LENGTH			152	// Length of the PUS packet.
+#define CC1120_CONFIG_SIZE		51	// Entries in cc1120_config[] (trans_lib.c).
+#define FLETCHER_BLOCK			21	// Bytes summed before reducing, the most that can't overflow 16 bits.
+
+/* RAM of COMS. The ATmega32M1 has 2048 bytes, COMS_OTHER_RAM of them hold every other global and
+ * the strings in .data, and COMS_STACK_RAM is kept for the stack. What is left holds dl_window[]
+ * and packet_list[]. Update COMS_OTHER_RAM (avr-size) when globals are added to COMS. */
+#define COMS_OTHER_RAM			1250
+#define COMS_STACK_RAM			256
+#define COMS_BUFFER_RAM			(2048 - COMS_OTHER_RAM - COMS_STACK_RAM)
+
+/* Uplink TC queue (COMS) */
+#define TC_QUEUE_RAM			(COMS_BUFFER_RAM - DL_WINDOW * DL_FRAME_RAM)	// Bytes of RAM given to TCs waiting for the OBC.
+#define TC_QUEUE_DEPTH			(TC_QUEUE_RAM / PACKET_LENGTH)
+#define TC_DROP_NEWEST			0	// A TC arriving at a full queue is refused (no ACK, the ground resends it).
+#define TC_DROP_OLDEST			1	// The oldest TC not yet being delivered makes room for it.
+#define TC_QUEUE_POLICY			TC_DROP_NEWEST
+
+/* Fragmentation (COMS) */
+#define FRAG_HEADER_LENGTH		2	// Packet id, (index << 4) | count.
+#define FRAG_DATA_LENGTH		76
+#define FRAG_FRAME_LENGTH		(FRAG_HEADER_LENGTH + FRAG_DATA_LENGTH)
+#define FRAG_COUNT				(PACKET_LENGTH / FRAG_DATA_LENGTH)
+#define FRAG_TIMEOUT			5000	// ms allowed between the first and last fragment of a packet.
+#define FRAG_NONE				0x100	// rx_frag_last before any packet has been completed.
+#if (FRAG_COUNT * FRAG_DATA_LENGTH != PACKET_LENGTH) || (FRAG_COUNT > 8)
+#error "A PUS packet must split into at most 8 whole fragments"
+#endif
+
+/* Downlink window (COMS) */
+#define DL_WINDOW				FRAG_COUNT	// TM frames sent before the oldest one has to be acknowledged.
+#define DL_FRAME_LENGTH			(1 + FRAG_FRAME_LENGTH)	// Sequence number + one fragment of the TM.
+#define DL_FRAME_RAM			(DL_FRAME_LENGTH + 6)	// sizeof(dl_frame) on the AVR (no padding).
+#if (DL_WINDOW < FRAG_COUNT)
+#error "The downlink window must hold at least one whole TM"
+#endif
+#if (TC_QUEUE_DEPTH < 2) || (TC_QUEUE_DEPTH > 255)
+#error "TC_QUEUE_RAM must hold between 2 and 255 packets, one being delivered and one being received"
+#endif
 
 #define COMMAND_OUT					0X01010101	// COMS: 0100
 #define COMMAND_IN					0x11111111	// PAY: 2000
@@ -107,11 +306,45 @@ typedef struct{
 #define SUB2_ID4				36
 #define SUB2_ID5				37
 
+/* CAN ACCEPTANCE FILTERS */
+// SUBn_ID0 - SUBn_ID5 are caught by two receive MObs, since a filter covers an aligned block of
+// 2^k IDs. Only ID bits 7-0 are compared (bits 10-8 may hold the priority class, see CAN_ID_CLASS_BITS).
+// can_api.c checks at compile time that the filters do not overlap and cover exactly
+// CAN_RX_ID_FIRST - CAN_RX_ID_LAST.
+#define CAN_NB_FILTERS			2
+#define CAN_FILTER0_MOB			1
+#define CAN_FILTER1_MOB			2
+#if (SELF_ID == 0)
+#define CAN_RX_ID_FIRST			SUB0_ID0
+#define CAN_RX_ID_LAST			SUB0_ID5
+#define CAN_FILTER0_ID			SUB0_ID0	// 20-23
+#define CAN_FILTER0_MASK		0xFC
+#define CAN_FILTER1_ID			SUB0_ID4	// 24-25
+#define CAN_FILTER1_MASK		0xFE
+#endif
+#if (SELF_ID == 1)
+#define CAN_RX_ID_FIRST			SUB1_ID0
+#define CAN_RX_ID_LAST			SUB1_ID5
+#define CAN_FILTER0_ID			SUB1_ID0	// 26-27
+#define CAN_FILTER0_MASK		0xFE
+#define CAN_FILTER1_ID			SUB1_ID2	// 28-31
+#define CAN_FILTER1_MASK		0xFC
+#endif
+#if (SELF_ID == 2)
+#define CAN_RX_ID_FIRST			SUB2_ID0
+#define CAN_RX_ID_LAST			SUB2_ID5
+#define CAN_FILTER0_ID			SUB2_ID0	// 32-35
+#define CAN_FILTER0_MASK		0xFC
+#define CAN_FILTER1_ID			SUB2_ID4	// 36-37
+#define CAN_FILTER1_MASK		0xFE
+#endif
+
 /* MessageType_ID  */
 #define MT_DATA					0x00
 #define MT_HK					0x01
 #define MT_COM					0x02
 #define MT_TC					0x03
+#define MT_TP					0x80	// Segmented transfer frame, the rest of the byte is the PCI (see below).
 
 /* SENDER_ID */
 #define COMS_ID					0x00
@@ -185,19 +418,64 @@ typedef struct{
 #define ENABLE_RADIO			0x2E
 #define DISABLE_UART			0x2F
 #define ENABLE_UART				0x30
+#define REQ_CAN_HEALTH			0x31
+#define REQ_CMD_LATENCY			0x32
+#define HK_ACK					0x33	// [3] = report count, [2] = frames below this were received, [1:0] = bitmap of the following ones.
+#define TIME_SYNC				0x34	// [4] = sequence, [3:0] = mission seconds.
+#define TIME_FUP				0x35	// [4] = sequence, [3:0] = us after those seconds at which TIME_SYNC was sent.
+#define CAN_RATE_SWITCH			0x36	// [4] = bit rate profile, [3:2] = ms after this frame at which to switch.
+#define CAN_RATE_TEST			0x37	// [4] = frames in the burst (0 = CAN_RATE_TEST_FRAMES).
+#define REQ_RF_LINK				0x38
+#define NUM_SMALL_TYPES			0x39	// Highest COMMAND SMALL-TYPE + 1 (size of the dispatch table).
 
 /* Checksum only */
 #define SAFE_MODE_VAR			0x09
 
 #define SMALLTYPE_DEFAULT		0x00
 
+/* HK SMALL-TYPE	   */
+#define HK_SINGLE				0x00	// [4] = sensor name, [1:0] = value.
+#define HK_PACKED_FRAME			0x01	// [4] = frame sequence, [3:2] = value 2n, [1:0] = value 2n+1.
+#define HK_PACKED_END			0x02	// [4] = # of frames, [3] = # of values, [2] = report count, [1:0] = Fletcher-16.
+#define HK_CAN_HEALTH			0x03	// [4] = frame sequence, see send_can_health().
+#define HK_CMD_LATENCY			0x04	// [4] = frame sequence, see send_cmd_latency().
+#define HK_RATE_TEST			0x05	// [4] = frame sequence, 0xFF = result, see can_rate_test().
+#define HK_RF_LINK				0x06	// [4] = frame sequence, see send_rf_link().
+
+/* SEGMENTED TRANSFER (BYTE 6 = MT_TP | TYPE | LOW NIBBLE) */
+#define TP_TYPE_MASK			0x70
+#define TP_LOW_MASK				0x0F
+#define TP_FF					0x10	// First frame: [5] = packet length, [4:0] = bytes 0-4.
+#define TP_CF					0x20	// Consecutive frame: low nibble = sequence number, [5:0] = next 6 bytes.
+#define TP_FC					0x30	// Flow control: low nibble = TP_FS_..., [5] = block size, [4] = STmin (ms).
+#define TP_ACK					0x40	// Completion: [5] = TP_ACK_OK / TP_ACK_FAIL, [4] = bytes received.
+#define TP_FS_CTS				0x00	// Continue to send.
+#define TP_FS_WAIT				0x01	// Not ready yet, wait for the next flow control.
+#define TP_FS_OVFLW				0x02	// Cannot take the packet, abort.
+#define TP_ACK_OK				0x00
+#define TP_ACK_FAIL				0xFF
+#define TP_FF_BYTES				5
+#define TP_CF_BYTES				6
+#define TP_BLOCK_SIZE			4		// CFs we accept before sending another FC (must fit in the RX ring).
+#define TP_STMIN_MS				0		// Separation time we ask of the OBC.
+#define TP_TIMEOUT_US			100000	// Max wait for a flow control or the next consecutive frame.
+#define TP_ACK_TIMEOUT_US		1000000	// Max wait for the completion acknowledgement.
+#define TP_MAX_RETRIES			3		// Attempts at sending a TC before it is dropped.
+
+#define TP_IDLE					0
+#define TP_WAIT_FC				1
+#define TP_SENDING				2
+#define TP_WAIT_ACK				3
+#define TP_RECEIVING			4
+
 /* DATA SMALL-TYPE	   */
 #define SPI_TEMP1				0x01
 #define COMS_PACKET				0x02
 #define BATT_TOP				0x03
 #define BATT_BOTTOM				0x04
 
-/* MESSAGE PRIORITIES	*/
+/* MESSAGE PRIORITIES	*/	// Higher is more urgent, see can_message_prio().
+#define URGENT_PRIO				30
 #define COMMAND_PRIO			25
 #define HK_REQUEST_PRIO			20
 #define DATA_PRIO				10
@@ -306,6 +584,10 @@ typedef struct{
 #define PAY_TEMP				0x64
 #define PAY_ACCEL_Y				0x65
 #define PAY_ACCEL_Z				0x66
+#define COMS_RSSI				0x67
+#define COMS_LQI				0x68
+#define COMS_FREQOFF			0x69
+#define COMS_RF_REJECTED		0x6A
 
 /* VARIABLE NAMES		*/
 #define MPPTX					0xFF
@@ -332,18 +614,35 @@ typedef struct{
 #define EPS_FDIR_SIGNAL			0xEA
 #define PAY_FDIR_SIGNAL			0xE9
 #define BATT_HEAT				0xE8
+#define HK_PACING				0xE7
 
 /* Global variables for modifying configuration mid-run */
 uint8_t uart_disable;
+uint8_t hk_pacing_ms;		// Gap between housekeeping frames (ms).
+uint8_t hk_report_count;	// Incremented for every packed housekeeping report.
+
+/* Acknowledged housekeeping delivery (hk_arq.c) */
+#if (HK_PACKED)
+hk_report hk_tx;					// The last packed report, kept until the OBC has acknowledged it.
+uint8_t hk_tx_data[HK_MAX_FRAMES][4];	// Bytes 3-0 of each of its frames.
+uint8_t hk_peer_acks;				// Set once the OBC has sent an HK_ACK, no retransmissions before that.
+#endif
+uint16_t hk_retransmitted;			// Frames sent again because they were not acknowledged.
+uint16_t hk_lost;					// Frames which were never acknowledged.
 
 /* Global variables to be used for CAN communication */
-uint8_t	status, mob_number, send_now, send_hk, send_data, set_sens_h, set_sens_l, set_varf, ask_alive;
-uint8_t enter_low_powerf, exit_low_powerf, enter_take_overf, exit_take_overf, pause_operationsf, resume_operationsf, deploy_antennaf;
-uint8_t turn_off_deployf, antenna_deployed;
-uint8_t read_response, write_response, open_valvesf, collect_pdf;
-uint8_t receive_arr[8], send_arr[8], read_arr[8], write_arr[8], data_req_arr[8];
-uint8_t sensh_arr[8], sensl_arr[8], setv_arr[8], pause_msg[8], resume_msg[8];
-uint8_t id_array[6];	// Necessary due to the different mailbox IDs for COMS, EPS, PAYL.
+uint8_t	status, ask_alive;
+uint8_t antenna_deployed;
+uint8_t send_arr[8];
+
+/* Pending command queue (filled by decode_command(), emptied by run_commands()) */
+uint8_t cmd_queue[CMD_QUEUE_SIZE][8];		// Copies of the command messages, SMALL-TYPE is in [5].
+uint8_t cmd_queue_head, cmd_queue_count;
+uint8_t cmd_dropped;						// Commands refused because the queue was full.
+#if (CAN_LATENCY_STATS)
+uint32_t cmd_queue_stamp[CMD_QUEUE_SIZE];	// Reception time of each queued command (see can_rx_stamp).
+cmd_latency cmd_lat[CMD_LAT_SLOTS];			// Reception -> handled, per command type.
+#endif
 
 #if (SELF_ID == 1)
 /* Global Variables for EPS		*/
@@ -359,6 +658,17 @@ uint16_t temp_old, press_old, acc_x_old, acc_y_old, acc_z_old;
 // Global variable used to store the current minute (updated by a CAN message from the OBC)
 uint8_t CURRENT_MINUTE;
 
+/* CAN bit rate (can_rate.c) */
+uint8_t can_rate;					// Bit rate profile in use.
+uint8_t can_rate_state;				// CAN_RATE_STABLE, CAN_RATE_SCHEDULED, CAN_RATE_TRIAL.
+uint8_t can_rate_next;				// Profile to switch to.
+uint32_t can_rate_at;				// can_time_us() of the switch / start of the trial.
+uint16_t can_rate_frames;			// can_frames when the trial started.
+uint8_t can_rate_fallbacks;			// Switches which failed and went back to CAN_RATE_DEFAULT.
+
+/* Mission clock, disciplined by TIME_SYNC / TIME_FUP from the OBC (time_sync.c) */
+mission_clock mclock;
+
 // Global variables for the different modes that the SSM can be in.
 uint8_t LOW_POWER_MODE;
 uint8_t PAUSE;
@@ -366,22 +676,64 @@ uint8_t PAUSE;
 /* Signal for FDIR Error Handling (SSM Loops on this) */
 uint8_t ssm_fdir_signal;
 
-uint8_t data0[DATA_BUFFER_SIZE];	// Data Buffer for MOb0
-uint8_t data1[DATA_BUFFER_SIZE];	// Data Buffer for MOb1
-uint8_t data2[DATA_BUFFER_SIZE];	// Data Buffer for MOb2
-uint8_t data3[DATA_BUFFER_SIZE];	// Data Buffer for MOb3
-uint8_t data4[DATA_BUFFER_SIZE];	// Data Buffer for MOb4
-uint8_t data5[DATA_BUFFER_SIZE];	// Data Buffer for MOb5
+/* CAN receive ring buffer (filled by CAN_INT_vect, drained by can_check_general()) */
+volatile uint8_t can_rx_ring[CAN_RX_RING_SIZE][8];
+volatile uint8_t can_rx_head;		// Only written by the ISR.
+volatile uint8_t can_rx_tail;		// Only written by the main loop.
+volatile uint16_t can_rx_overruns;	// Frames dropped because the ring was full.
+volatile uint8_t can_rx_high_water;	// Largest number of frames which were waiting in the ring.
+volatile uint32_t can_rx_stamp[CAN_RX_RING_SIZE];	// Hardware timestamp (us) of each frame in the ring.
+uint32_t can_rx_time;				// Timestamp of the frame currently being decoded.
+#if (CAN_LATENCY_STATS)
+uint32_t can_rx_age_max;			// Longest time (us) a frame waited before being decoded.
+uint16_t can_rx_late;				// Frames which waited longer than CAN_RX_LATE_US.
+#endif
+
+/* CAN transmit queue (filled by can_queue_message(), drained by CAN_INT_vect) */
+volatile can_frame can_tx_queue[CAN_TX_CLASSES][CAN_TX_CLASS_SIZE];	// A FIFO per priority class.
+volatile uint8_t can_tx_head[CAN_TX_CLASSES];	// Oldest frame of each class.
+volatile uint8_t can_tx_count[CAN_TX_CLASSES];	// Frames waiting in each class.
+volatile uint8_t can_tx_high_water[CAN_TX_CLASSES];	// Most frames which were waiting in each class.
+#if (CAN_LATENCY_STATS)
+volatile uint16_t can_tx_sent[CAN_TX_CLASSES];	// Frames of each class loaded into a MOb.
+volatile uint16_t can_tx_wait_max[CAN_TX_CLASSES];	// Longest queueing delay, in units of (1 << CMD_LAT_SHIFT) us.
+volatile uint32_t can_tx_wait_sum[CAN_TX_CLASSES];	// Sum of the queueing delays, same units.
+#endif
+volatile uint8_t can_tx_busy;		// Bit i is set while MOb i is transmitting.
+volatile uint16_t can_tx_dropped;	// Frames refused because the queue stayed full.
+volatile uint32_t can_tx_time;		// Hardware timestamp (us) of the last frame sent.
+
+/* CAN health (can_health.c), all error counters saturate at 0xFF */
+volatile uint8_t can_mob_errors[CAN_NB_MOB][CAN_ERR_TYPES];	// Error flags seen on each MOb.
+uint8_t can_gen_errors[CAN_ERR_TYPES];	// General error flags (CANGIT).
+uint8_t can_tec_max, can_rec_max;		// Highest CANTEC / CANREC seen.
+uint8_t can_errp_count;					// Transitions into error-passive.
+uint8_t can_boff_count;					// Transitions into bus-off.
+uint8_t can_errp, can_bus_off;			// Current state.
+uint8_t can_boff_backoff;				// Polls to wait after the next bus-off.
+uint8_t can_boff_wait, can_boff_stable;
+volatile uint16_t can_tim_ovf;			// Upper 16 bits of the CAN timer (see can_time_us()).
+uint32_t can_tim_base;					// can_time_us() when the CAN controller was last reset.
+volatile uint16_t can_frames;			// Frames sent or received by this SSM.
+uint16_t can_util_frames;				// can_frames at the start of the utilisation window.
+uint32_t can_util_start;
+uint16_t can_util;						// Bus utilisation by this SSM (per-mille).
 
 uint8_t event_readyf;
 uint8_t event_arr[8];
 
 #if (SELF_ID == 0)
 /* Global variables used for PUS packet communication */
-uint8_t new_tm_msg[8], new_tc_msg[8], tm_sequence_count, new_tm_msgf, current_tm_fullf, tc_packet_readyf;
+uint8_t new_tc_msg[8], tm_sequence_count, new_tm_msgf, current_tm_fullf, tc_packet_readyf;
 uint8_t alert_deployf;
 uint8_t tc_transfer_completef, start_tc_transferf, receiving_tmf;
-uint8_t current_tm[PACKET_LENGTH], tm_to_downlink[PACKET_LENGTH], current_tc[PACKET_LENGTH];
+uint8_t current_tm[PACKET_LENGTH];
+uint8_t* current_tc;				// Oldest TC in packet_list[], delivered in place.
+#if (PUS_SEGMENTED)
+tp_channel tp_tx;					// TC from COMS to the OBC.
+tp_channel tp_rx;					// TM from the OBC to COMS.
+uint8_t tp_tc_loaded;				// current_tc[] holds a TC which has not been delivered yet.
+#endif
 
 // Global Flags and Constants for Coms TakeOver
 uint8_t TAKEOVER;					// Coms is taking over for OBC
@@ -407,25 +759,69 @@ uint8_t new_packet[152];
 uint8_t packet_receivedf;
 uint8_t current_transceiver;
 uint32_t countcycles;
-uint8_t last_rx_packet_height;
-uint8_t last_tx_packet_height;
 uint32_t receiving_sequence_control;
 uint32_t transmitting_sequence_control;
 uint8_t test_reg[6];
-uint8_t t_message[128];
 uint8_t tx_fail_count;
 uint8_t ack_acquired;
-long int lastCalibration;
+long int lastCalibration;			// millis() of the last SCAL (uhf_calibrate()).
+long int lastCalCheck;
+long int lastReceive;				// millis() of the last packet read from the RX FIFO.
+uint8_t uhf_cal_pending;			// CAL_... reasons waiting for the link to go quiet.
+uint8_t uhf_cal_reasons;			// Every reason acted on so far.
+uint16_t uhf_cal_temp;				// coms_temp, rf_freqoff average and rf_frames at the last
+int16_t uhf_cal_freqoff;			// calibration.
+uint16_t uhf_cal_frames;
+uint16_t uhf_cals;
+uint16_t coms_temp;					// deg C, last read by the housekeeping (0 = not yet).
 long int startedReceivingTM;
-uint8_t low_half_acquired;
+volatile uint8_t trans_irqf;		// End of packet seen on GPIO0 (PCINT2_vect).
+uint8_t trans_state;				// TRANS_LISTEN, TRANS_TURNAROUND, TRANS_TX.
+uint8_t trans_reply;				// Send ACK/ANT once the turnaround is over.
+long int trans_timer;				// millis() when the current state was entered.
+uint16_t uhf_reinits;				// Resets because the registers could not be repaired.
+uint16_t uhf_upsets;				// Registers found different from uhf_shadow[] by reg_scrub().
+uint8_t uhf_shadow[CC1120_CONFIG_SIZE];	// What each register in cc1120_config[] should hold right now.
+
+/* RF link quality of every packet received (rf_link_record()) */
+rf_stat rf_rssi;					// dBm as appended by the CC1120 (before the RSSI offset).
+rf_stat rf_lqi;						// 0 - 127, lower is better.
+rf_stat rf_freqoff;					// FREQOFF_EST, signed, f_xosc / 2^18 Hz per count.
+uint16_t rf_frames;					// Packets read out of the FIFO.
+uint16_t rf_rejected;				// Flushed by the CC1120 (wrong address) before we saw them.
+
+/* Uplink reassembly (frag.c) */
+uint8_t rx_frag_id;					// Packet being reassembled.
+uint8_t rx_frag_have;				// Bit n is set once fragment n is in place, 0 = nothing yet.
+long int rx_frag_started;			// millis() when its first fragment arrived.
+uint16_t rx_frag_last;				// Id of the last packet completed, FRAG_NONE at first and after FRAG_TIMEOUT.
+long int rx_frag_completed;			// millis() when it was completed.
+uint16_t rx_frag_timeouts;			// Partial packets given up on.
+uint16_t rx_frag_duplicates;
+
+/* Downlink window (dl_arq.c) */
+dl_frame dl_window[DL_WINDOW];				// DL_WINDOW frames, oldest at dl_head.
+uint8_t dl_head;
+uint8_t dl_packet_id;				// Fragment packet id of the next TM.
+uint8_t dl_count;					// Frames in the window, acknowledged or not.
+uint16_t dl_srtt;					// Smoothed round-trip time (ms), 0 = no sample yet.
+uint16_t dl_rto;					// Retransmission timeout (ms).
+uint16_t dl_gap;					// Time between two transmissions (ms).
+uint16_t dl_retransmits;
+uint16_t dl_acked;
 
 /* Global variables used for operational timeouts */
 uint32_t ssm_ok_go_timeout;
 uint8_t ssm_consec_trans_timeout;
 
-/* Pointers to the packet list (for buffering) */
-packet packet_list[5];
+/* Circular queue of uplinked TCs (for buffering) */
+packet packet_list[TC_QUEUE_DEPTH];
 uint8_t packet_count;
+uint8_t tc_head;					// Slot of the oldest TC.
+uint8_t tc_head_busy;				// The oldest TC is being delivered to the OBC, don't drop it.
+uint16_t tc_overflows;				// TCs which arrived while the queue was full.
+uint16_t tc_dropped_oldest;			// Queued TCs thrown away to make room (TC_DROP_OLDEST).
+uint16_t tc_dropped_newest;			// New TCs refused because the queue was full.
 
 #endif
 
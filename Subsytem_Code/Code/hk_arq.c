@@ -0,0 +1,185 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		hk_arq.c
+	*
+	*	PURPOSE:	This program makes sure that a packed housekeeping report reaches the OBC. The
+	*				frames of the last report are kept in hk_tx_data[] and the OBC acknowledges
+	*				them with HK_ACK. Only the frames which were not acknowledged are sent again.
+	*
+	*	FILE REFERENCES:	hk_arq.h
+	*
+	*	EXTERNAL VARIABLES:	hk_tx, hk_tx_data, hk_peer_acks, hk_retransmitted, hk_lost
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	Only used when HK_PACKED == 1. hk_arq_poll() is called
+	*											from run_commands().
+	*
+	*	NOTES:	Frame n of a report has [4] = n, the last one is the HK_PACKED_END frame. The OBC answers
+	*			with an HK_ACK command:
+	*
+	*				[3]		report count (byte 2 of HK_PACKED_END)
+	*				[2]		cumulative, every frame below this one was received
+	*				[1:0]	bit i set = frame ([2] + i) was received as well
+	*
+	*			The OBC may acknowledge a report more than once. If it is still incomplete
+	*			HK_ACK_TIMEOUT_US after the last transmission, the missing frames are sent again, at
+	*			most HK_MAX_RETRIES times. A new REQ_HK replaces a report which is still outstanding.
+	*
+	*			Nothing is sent again until the first HK_ACK has been received. This way OBC firmware
+	*			which does not acknowledge housekeeping sees the same traffic as before.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+	*	10/17/2026			hk_tx / hk_tx_data only take RAM when HK_PACKED is set.
+	*
+*/
+
+#include "hk_arq.h"
+#include "can_api.h"
+
+void hk_arq_init(void)
+{
+#if (HK_PACKED)
+	hk_tx.frames = 0;
+	hk_tx.missing = 0;
+	hk_peer_acks = 0;
+#endif
+	hk_retransmitted = 0;
+	hk_lost = 0;
+	return;
+}
+
+#if (HK_PACKED)
+
+static uint8_t hk_count_frames(uint16_t frames);
+
+/************************************************************************/
+/* HK ARQ NEW REPORT                                                    */
+/*																		*/
+/* Called before hk_tx_data[] is filled with a new report. Frames of	*/
+/* the previous report which were never acknowledged are counted as		*/
+/* lost.																*/
+/************************************************************************/
+
+void hk_arq_new_report(void)
+{
+	if(hk_tx.frames && hk_peer_acks)
+		hk_lost += hk_count_frames(hk_tx.missing);
+	hk_tx.frames = 0;
+	hk_tx.missing = 0;
+	hk_tx.retries = 0;
+	return;
+}
+
+/************************************************************************/
+/* HK ARQ TRANSMIT                                                      */
+/*																		*/
+/* Sends frame n of the report in hk_tx_data[] for every bit n set in	*/
+/* frames. hk_tx.frames and hk_tx.report must already be set.			*/
+/************************************************************************/
+
+void hk_arq_transmit(uint16_t frames)
+{
+	uint8_t n, i;
+	
+	send_arr[7] = (SELF_ID << 4)|HK_TASK_ID;
+	send_arr[6] = MT_HK;
+	for (n = 0; n < hk_tx.frames; n++)
+	{
+		if(!(frames & (1 << n)))
+			continue;
+		if(n == (hk_tx.frames - 1))
+			send_arr[5] = HK_PACKED_END;
+		else
+			send_arr[5] = HK_PACKED_FRAME;
+		send_arr[4] = n;
+		for (i = 0; i < 4; i++)
+		{
+			send_arr[i] = hk_tx_data[n][i];
+		}
+		can_send_message(&(send_arr[0]), CAN1_MB6);		//CAN1_MB6 is the HK reception MB.
+		if(hk_pacing_ms)
+			delay_ms(hk_pacing_ms);
+	}
+	hk_tx.missing |= frames;
+	hk_tx.last = can_time_us();
+	return;
+}
+
+/************************************************************************/
+/* HK ARQ POLL                                                          */
+/*																		*/
+/* Sends the missing frames of the outstanding report again once		*/
+/* HK_ACK_TIMEOUT_US has passed without an acknowledgement, or gives up	*/
+/* on them after HK_MAX_RETRIES.										*/
+/************************************************************************/
+
+void hk_arq_poll(void)
+{
+	uint8_t count;
+	
+	if(!hk_tx.missing)
+		return;
+	if((can_time_us() - hk_tx.last) < HK_ACK_TIMEOUT_US)
+		return;
+	if(!hk_peer_acks)						// The OBC does not acknowledge housekeeping.
+	{
+		hk_tx.missing = 0;
+		return;
+	}
+	count = hk_count_frames(hk_tx.missing);
+	if(hk_tx.retries >= HK_MAX_RETRIES)
+	{
+		hk_lost += count;
+		hk_tx.missing = 0;
+		return;
+	}
+	hk_tx.retries++;
+	hk_retransmitted += count;
+	hk_arq_transmit(hk_tx.missing);
+	return;
+}
+
+/************************************************************************/
+/* HK ACK RECEIVED                                                      */
+/*																		*/
+/* Handler for HK_ACK, clears the frames which the OBC has received.	*/
+/************************************************************************/
+
+void hk_ack_received(uint8_t* command)
+{
+	uint32_t acked;
+	uint8_t cumulative = *(command + 2);
+	
+	hk_peer_acks = 1;
+	if(!hk_tx.frames || (*(command + 3) != hk_tx.report))
+		return;								// Not the report we are holding on to.
+	if(cumulative > 16)
+		cumulative = 16;
+	acked = ((uint32_t)1 << cumulative) - 1;
+	acked |= ((uint32_t)*(command + 1) << (cumulative + 8)) | ((uint32_t)*(command) << cumulative);
+	hk_tx.missing &= ~((uint16_t)acked);
+	return;
+}
+
+// Returns the number of bits set in frames.
+static uint8_t hk_count_frames(uint16_t frames)
+{
+	uint8_t count = 0;
+	
+	while(frames)
+	{
+		count += frames & 1;
+		frames >>= 1;
+	}
+	return count;
+}
+
+#endif
@@ -0,0 +1,38 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		hk_arq.h
+	*
+	*	PURPOSE:	This program contains the prototypes for hk_arq.c
+	*
+	*	FILE REFERENCES:	global_var.h
+	*
+	*	EXTERNAL VARIABLES:	
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+*/
+
+#ifndef HK_ARQ_H
+#define HK_ARQ_H
+
+#include "global_var.h"
+
+void hk_arq_init(void);
+void hk_arq_new_report(void);
+void hk_arq_transmit(uint16_t frames);
+void hk_arq_poll(void);
+void hk_ack_received(uint8_t* command);
+
+#endif
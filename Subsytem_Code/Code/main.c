@@ -155,19 +155,22 @@ int main(void)
     {	
 		/* Reset the WDT */
 		wdt_reset();
-		/* CHECK FOR A GENERAL INCOMING MESSAGE INTO MOB0 as well as HK into MOB5 */
+		/* DECODE CAN MESSAGES WHICH THE CAN INTERRUPT HAS PLACED IN THE RX RING */
 		can_check_general();
+		/* CAN ERROR COUNTERS, BUS UTILISATION AND BUS-OFF RECOVERY */
+		can_health_poll();
+		/* SCHEDULED BIT RATE SWITCH / FALLBACK */
+		can_rate_poll();
+		/* MISSION CLOCK (TIME_SYNC / TIME_FUP FROM THE OBC) */
+		time_sync_poll();
 		if(!PAUSE)
 		{
 			/*		TRANSCEIVER COMMUNICATION	*/
 			#if (SELF_ID == 0)
 				// If you are COMS, please check that receiving_tmf == 0 before
 				// doing anything that is time-intensive (takes more than 10 ms).
-				if(!receiving_tmf)
-				{
-					delay_ms(50);
+				if(!receiving_tmf && !tp_rx_busy())
 					transceiver_run();
-				}
 				if(millis() - startedReceivingTM > TM_TIMEOUT)
 					receiving_tmf = 0;
 				// Continually check if COMS needs to takeover for OBC
@@ -358,23 +361,13 @@ static void init_global_vars(void)
 {	
 	uint8_t i, j;
 	#if (SELF_ID == 0)			// COMS Variable Initialization
-		id_array[0] = SUB0_ID0;
-		id_array[1] = SUB0_ID1;
-		id_array[2] = SUB0_ID2;
-		id_array[3] = SUB0_ID3;
-		id_array[4] = SUB0_ID4;
-		id_array[5] = SUB0_ID5;
-		
 		for (i = 0; i < 152; i++)		// Initialize the TM/TC Packet arrays.
 		{
 			current_tm[i] = 0;
-			current_tc[i] = 0;
-			tm_to_downlink[i] = i;
 			new_packet[i] = 0;
 		}
 		for (i = 0; i < 8; i++)
 		{
-			new_tm_msg[i] = 0;
 			new_tc_msg[i] = 0;		
 		}
 
@@ -403,20 +396,35 @@ static void init_global_vars(void)
 		count32ms = 0;
 		packet_receivedf = 0;
 		current_transceiver = 0;
-		last_rx_packet_height = 0;
-		last_tx_packet_height = 0xFF;
 		receiving_sequence_control = 0;
 		transmitting_sequence_control = 0;
 		tx_fail_count = 0;
 		ack_acquired = 0;
 		lastCalibration = 0;
+		lastCalCheck = 0;
+		lastReceive = 0;
+		uhf_cal_pending = 0;
+		uhf_cal_reasons = 0;
+		uhf_cal_temp = 0;
+		uhf_cal_freqoff = 0;
+		uhf_cal_frames = 0;
+		uhf_cals = 0;
+		coms_temp = 0;
 		current_transceiver = 0;
 		lastAck = 0;
-		low_half_acquired = 0;
 		startedReceivingTM = 0;
+		trans_irqf = 0;
+		trans_state = TRANS_LISTEN;
+		trans_reply = 0;
+		trans_timer = 0;
+		uhf_reinits = 0;
+		uhf_upsets = 0;
+		rf_frames = 0;
+		rf_rejected = 0;
+		rf_link_reset();
 
 		/* PUS Packet Variables */
-		for(j = 0; j < 5; j++)
+		for(j = 0; j < TC_QUEUE_DEPTH; j++)
 		{
 			for(i = 0; i < 152; i++)
 			{
@@ -426,9 +434,14 @@ static void init_global_vars(void)
 		for(i = 0; i < 77; i ++)
 		{
 			new_packet[i] = i;
-			t_message[i] = i;
 		}
 		packet_count = 0;
+		tc_head = 0;
+		tc_head_busy = 0;
+		tc_overflows = 0;
+		tc_dropped_oldest = 0;
+		tc_dropped_newest = 0;
+		current_tc = packet_list[0].data;
 		
 		/* Command Flags */
 		new_tm_msgf = 0;
@@ -438,20 +451,14 @@ static void init_global_vars(void)
 		tc_transfer_completef = 0;
 		start_tc_transferf = 0;
 		receiving_tmf = 0;
+		tp_init();
+		dl_arq_init();
+		frag_init();
 		ask_alive = 0;
-		enter_take_overf = 0;
-		exit_take_overf = 0;
 		alert_deployf = 0;
 	
 	#endif
 	#if (SELF_ID == 1)			// EPS Variable Initialization
-		id_array[0] = SUB1_ID0;
-		id_array[1] = SUB1_ID1;
-		id_array[2] = SUB1_ID2;
-		id_array[3] = SUB1_ID3;
-		id_array[4] = SUB1_ID4;
-		id_array[5] = SUB1_ID5;
-
 		/* Dummy Values for Testing Housekeeping */
 		pxv = 0x01;
 		pxi = 0x02;
@@ -469,56 +476,39 @@ static void init_global_vars(void)
 		payi = 0x0E;
 		obcv = 0x0F;
 		obci = 0x10;
-		
-		/* Command Flags */
-		enter_low_powerf = 0;
-		exit_low_powerf = 0;
 	
 	#endif
 	#if (SELF_ID == 2)			// PAY Variable Initialization
-		id_array[0] = SUB2_ID0;
-		id_array[1] = SUB2_ID1;
-		id_array[2] = SUB2_ID2;
-		id_array[3] = SUB2_ID3;
-		id_array[4] = SUB2_ID4;
-		id_array[5] = SUB2_ID5;
-		
-		/* Command Flags */
-		open_valvesf = 0;
-		collect_pdf = 0;
 	#endif
 	
 	/* Common Variable Initialization */	
 	for (i = 0; i < 8; i ++)
 	{
-		receive_arr[i] = 0;			// Reset the message array to zero after each message.
 		send_arr[i] = 0;
-		read_arr[i] = 0;
-		write_arr[i] = 0;
-		data_req_arr[i] = 0;
-		sensh_arr[i] = 0;
-		sensl_arr[i] = 0;
-		setv_arr[i] = 0;
 		event_arr[i] = 0;
-		pause_msg[i] = 0;
-		resume_msg[i] = 0;
 	}
 	
+	/* Command queue (see decode_command()) */
+	cmd_queue_head = 0;
+	cmd_queue_count = 0;
+	cmd_dropped = 0;
+	
 	uart_disable = UART_DISABLE;
+	hk_pacing_ms = HK_PACING_MS;
+	hk_report_count = 0;
+	hk_arq_init();
+
+	/* CAN receive ring / transmit queue statistics */
+	can_rx_head = 0;
+	can_rx_tail = 0;
+	can_rx_overruns = 0;
+	can_rx_high_water = 0;
+	can_tx_dropped = 0;
+	can_health_init();
+	can_rate_init();
+	time_sync_init();
 
 	/* Initialize Global Command Flags to zero */
-	send_now = 0;
-	send_hk = 0;
-	send_data = 0;
-	read_response = 0;
-	write_response = 0;
-	set_sens_h = 0;
-	set_sens_l = 0;
-	set_varf = 0;
-	pause_operationsf = 0;
-	resume_operationsf = 0;	
-	deploy_antennaf = 0;
-	turn_off_deployf = 0;
 	event_readyf = 0;
 	antenna_deployed = 0;
 
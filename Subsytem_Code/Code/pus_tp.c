@@ -0,0 +1,339 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		pus_tp.c
+	*
+	*	PURPOSE:	This program moves PUS packets between COMS and the OBC with a segmented
+	*				transfer (similar to ISO-TP) instead of one 4-byte CAN message per SEND_TM / SEND_TC.
+	*
+	*	FILE REFERENCES:	pus_tp.h
+	*
+	*	EXTERNAL VARIABLES:	tp_tx, tp_rx, current_tm, current_tc
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	Only used by COMS when PUS_SEGMENTED == 1.
+	*
+	*	NOTES:	Byte 7 of every frame is the usual FROM/TO byte. Byte 6 is MT_TP plus the frame type
+	*			and a 4-bit field, which leaves bytes 5-0 for data:
+	*
+	*			FF	(first frame)		[5] = length, [4:0] = bytes 0-4 of the packet.
+	*			CF	(consecutive frame)	low nibble = sequence number (1, 2, ... 15, 0, ...), [5:0] = data.
+	*			FC	(flow control)		low nibble = CTS / WAIT / OVFLW, [5] = block size, [4] = STmin.
+	*			ACK	(completion)		[5] = TP_ACK_OK or TP_ACK_FAIL, [4] = bytes received.
+	*
+	*			The sender starts with an FF and waits for an FC. It then sends block-size CFs
+	*			(all of them if the block size is 0) at least STmin ms apart before waiting for the next
+	*			FC. The receiver sends a single ACK when the packet is complete (or broken).
+	*			A 152-byte packet takes 26 frames instead of 38 (plus the 38 replies of the old scheme).
+	*
+	*			Nothing in here waits: incoming frames are handled by tp_receive() as they are decoded
+	*			and tp_poll() (called from run_commands()) sends what it can and handles timeouts.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+	*	10/17/2026			tp_tx / tp_rx only take RAM when PUS_SEGMENTED is set.
+	*
+*/
+
+#include "pus_tp.h"
+#include "can_api.h"
+
+#if (SELF_ID == 0)
+
+void tp_init(void)
+{
+#if (PUS_SEGMENTED)
+	tp_tx.state = TP_IDLE;
+	tp_tx.retries = 0;
+	tp_rx.state = TP_IDLE;
+	tp_tc_loaded = 0;
+#endif
+	return;
+}
+
+// Returns 1 while a TM from the OBC is being reassembled. A TC being sent spends most of its
+// time waiting for flow control / the ACK, so it doesn't count.
+uint8_t tp_rx_busy(void)
+{
+#if (PUS_SEGMENTED)
+	return (tp_rx.state != TP_IDLE);
+#else
+	return 0;
+#endif
+}
+
+#if (PUS_SEGMENTED)
+
+static void tp_send_frame(uint8_t peer, uint8_t pci, uint8_t* data, uint8_t count);
+static void tp_send_fc(uint8_t status);
+static void tp_send_ack(uint8_t status, uint8_t length);
+static void tp_tx_failed(void);
+static void tp_rx_abort(void);
+
+/************************************************************************/
+/* TP POLL                                                              */
+/*																		*/
+/* Starts sending the next TC in packet_list[] when the channel is free	*/
+/* and sends as many consecutive frames as the block size, STmin and	*/
+/* the CAN transmit queue allow. Also times out stalled transfers.		*/
+/************************************************************************/
+
+void tp_poll(void)
+{
+	uint8_t count;
+	uint32_t now = can_time_us();
+	
+	if((tp_rx.state == TP_RECEIVING) && ((now - tp_rx.last) > TP_TIMEOUT_US))
+		tp_rx_abort();
+	
+	switch(tp_tx.state)
+	{
+		case TP_IDLE:
+			if(!tp_tc_loaded)
+			{
+				if(!packet_count)
+					return;
+				load_packet_to_current_tc();
+				tp_tc_loaded = 1;
+				tp_tx.retries = 0;
+			}
+			tp_tx.peer = OBC_PACKET_ROUTER_ID;
+			tp_tx.length = PACKET_LENGTH;
+			tp_send_frame(tp_tx.peer, TP_FF, &current_tc[0], TP_FF_BYTES);
+			tp_tx.offset = TP_FF_BYTES;
+			tp_tx.sn = 1;
+			tp_tx.state = TP_WAIT_FC;
+			tp_tx.last = now;
+			return;
+		case TP_WAIT_FC:
+			if((now - tp_tx.last) > TP_TIMEOUT_US)
+				tp_tx_failed();
+			return;
+		case TP_SENDING:
+			while(tp_tx.offset < tp_tx.length)
+			{
+				if(!can_tx_room(DATA_PRIO))
+					return;						// Try again on the next poll.
+				if(tp_tx.stmin && ((now - tp_tx.last) < ((uint32_t)tp_tx.stmin * 1000)))
+					return;
+				count = tp_tx.length - tp_tx.offset;
+				if(count > TP_CF_BYTES)
+					count = TP_CF_BYTES;
+				tp_send_frame(tp_tx.peer, TP_CF | tp_tx.sn, &current_tc[tp_tx.offset], count);
+				tp_tx.offset += count;
+				tp_tx.sn = (tp_tx.sn + 1) & TP_LOW_MASK;
+				tp_tx.last = now;
+				if(tp_tx.bs && !(--tp_tx.block_left) && (tp_tx.offset < tp_tx.length))
+				{
+					tp_tx.state = TP_WAIT_FC;
+					return;
+				}
+				if(tp_tx.stmin)
+					return;
+			}
+			tp_tx.state = TP_WAIT_ACK;
+			return;
+		case TP_WAIT_ACK:
+			if((now - tp_tx.last) > TP_ACK_TIMEOUT_US)
+				tp_tx_failed();
+			return;
+		default:
+			tp_tx.state = TP_IDLE;
+			return;
+	}
+}
+
+/************************************************************************/
+/* TP RECEIVE                                                           */
+/*																		*/
+/* Called by can_check_general() for every frame with MT_TP set.		*/
+/* FC and ACK frames belong to the TC we are sending, FF and CF frames	*/
+/* to a TM which the OBC is sending us.									*/
+/************************************************************************/
+
+void tp_receive(uint8_t* frame)
+{
+	uint8_t i, count, type, low;
+	
+	type = frame[6] & TP_TYPE_MASK;
+	low = frame[6] & TP_LOW_MASK;
+	
+	switch(type)
+	{
+		case TP_FC:
+			if(tp_tx.state != TP_WAIT_FC)
+				return;
+			tp_tx.last = can_rx_time;
+			if(low == TP_FS_WAIT)
+				return;
+			if(low != TP_FS_CTS)
+			{
+				tp_tx_failed();
+				return;
+			}
+			tp_tx.bs = frame[5];
+			tp_tx.block_left = frame[5];
+			tp_tx.stmin = frame[4];
+			tp_tx.state = TP_SENDING;
+			return;
+		case TP_ACK:
+			if(tp_tx.state != TP_WAIT_ACK)
+				return;
+			if((frame[5] == TP_ACK_OK) && (frame[4] == tp_tx.length))
+			{
+				tp_tx.state = TP_IDLE;
+				tp_tc_loaded = 0;
+				release_current_tc();
+				tc_packet_readyf = 0;
+			}
+			else
+				tp_tx_failed();
+			return;
+		case TP_FF:
+			if(tp_rx.state == TP_RECEIVING)
+				tp_rx_abort();					// The OBC gave up on the last one.
+			tp_rx.peer = frame[7] & 0x0F;		// Reply to whichever task is sending.
+			if(current_tm_fullf || (frame[5] != PACKET_LENGTH))
+			{
+				tp_send_fc(TP_FS_OVFLW);
+				return;
+			}
+			tp_rx.length = frame[5];
+			for (i = 0; i < TP_FF_BYTES; i++)
+			{
+				current_tm[i] = frame[4 - i];
+			}
+			tp_rx.offset = TP_FF_BYTES;
+			tp_rx.sn = 1;
+			tp_rx.block_left = TP_BLOCK_SIZE;
+			tp_rx.last = can_rx_time;
+			tp_rx.state = TP_RECEIVING;
+			receiving_tmf = 1;
+			startedReceivingTM = millis();
+			tp_send_fc(TP_FS_CTS);
+			return;
+		case TP_CF:
+			if(tp_rx.state != TP_RECEIVING)
+				return;
+			if(low != tp_rx.sn)
+			{
+				tp_rx_abort();
+				return;
+			}
+			count = tp_rx.length - tp_rx.offset;
+			if(count > TP_CF_BYTES)
+				count = TP_CF_BYTES;
+			for (i = 0; i < count; i++)
+			{
+				current_tm[tp_rx.offset + i] = frame[5 - i];
+			}
+			tp_rx.offset += count;
+			tp_rx.sn = (tp_rx.sn + 1) & TP_LOW_MASK;
+			tp_rx.last = can_rx_time;
+			if(tp_rx.offset >= tp_rx.length)
+			{
+				tp_rx.state = TP_IDLE;
+				receiving_tmf = 0;
+				current_tm_fullf = 1;			// TM buffer now full, ready to downlink to ground.
+				store_current_tm();
+				tp_send_ack(TP_ACK_OK, tp_rx.length);
+				return;
+			}
+			if(!(--tp_rx.block_left))
+			{
+				tp_rx.block_left = TP_BLOCK_SIZE;
+				tp_send_fc(TP_FS_CTS);
+			}
+			return;
+		default:
+			return;
+	}
+}
+
+// Helper: data[0] goes in byte 5 (CF) or byte 4 (FF), and so on down to byte 0.
+static void tp_send_frame(uint8_t peer, uint8_t pci, uint8_t* data, uint8_t count)
+{
+	uint8_t i, top;
+	
+	top = ((pci & TP_TYPE_MASK) == TP_FF) ? 4 : 5;
+	send_arr[7] = (SELF_ID << 4)|peer;
+	send_arr[6] = MT_TP | pci;
+	for (i = 0; i < 6; i++)
+	{
+		send_arr[i] = 0;
+	}
+	if((pci & TP_TYPE_MASK) == TP_FF)
+		send_arr[5] = tp_tx.length;
+	for (i = 0; i < count; i++)
+	{
+		send_arr[top - i] = data[i];
+	}
+	can_send_message(&(send_arr[0]), CAN1_MB2);		//CAN1_MB2 is the TM/TC reception MB.
+	return;
+}
+
+// Helper
+static void tp_send_fc(uint8_t status)
+{
+	send_arr[7] = (SELF_ID << 4)|tp_rx.peer;
+	send_arr[6] = MT_TP | TP_FC | status;
+	send_arr[5] = TP_BLOCK_SIZE;
+	send_arr[4] = TP_STMIN_MS;
+	send_arr[3] = 0;
+	send_arr[2] = 0;
+	send_arr[1] = 0;
+	send_arr[0] = 0;
+	can_send_message(&(send_arr[0]), CAN1_MB2);
+	return;
+}
+
+// Helper
+static void tp_send_ack(uint8_t status, uint8_t length)
+{
+	send_arr[7] = (SELF_ID << 4)|tp_rx.peer;
+	send_arr[6] = MT_TP | TP_ACK;
+	send_arr[5] = status;
+	send_arr[4] = length;
+	send_arr[3] = 0;
+	send_arr[2] = 0;
+	send_arr[1] = 0;
+	send_arr[0] = 0;
+	can_send_message(&(send_arr[0]), CAN1_MB2);
+	return;
+}
+
+// Helper: start the TC over on the next poll, or drop it after TP_MAX_RETRIES.
+static void tp_tx_failed(void)
+{
+	tp_tx.state = TP_IDLE;
+	if(++tp_tx.retries >= TP_MAX_RETRIES)
+	{
+		tp_tc_loaded = 0;
+		release_current_tc();
+	}
+	return;
+}
+
+// Helper
+static void tp_rx_abort(void)
+{
+	uint8_t i;
+	
+	tp_send_ack(TP_ACK_FAIL, tp_rx.offset);
+	tp_rx.state = TP_IDLE;
+	receiving_tmf = 0;
+	for (i = 0; i < PACKET_LENGTH; i++)
+	{
+		current_tm[i] = 0;
+	}
+	return;
+}
+
+#endif		// PUS_SEGMENTED
+#endif
@@ -0,0 +1,37 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		pus_tp.h
+	*
+	*	PURPOSE:	This program contains the prototypes for pus_tp.c
+	*
+	*	FILE REFERENCES:	can_api.h, commands.h
+	*
+	*	EXTERNAL VARIABLES:	
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+*/
+
+#ifndef PUS_TP_H
+#define PUS_TP_H
+
+#include "global_var.h"
+
+void tp_init(void);
+void tp_poll(void);
+void tp_receive(uint8_t* frame);
+uint8_t tp_rx_busy(void);
+
+#endif
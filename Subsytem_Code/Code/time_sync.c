@@ -0,0 +1,216 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		time_sync.c
+	*
+	*	PURPOSE:	This program keeps a mission clock (32-bit milliseconds + microseconds) on every
+	*				SSM which follows the clock of the OBC. The OBC sends a TIME_SYNC frame followed by
+	*				a TIME_FUP which holds the exact time at which the TIME_SYNC went out. Since we
+	*				know when the TIME_SYNC arrived (its CAN timestamp), the two give us the offset of
+	*				our clock, and two syncs in a row give us the drift.
+	*
+	*	FILE REFERENCES:	time_sync.h
+	*
+	*	EXTERNAL VARIABLES:	mclock, CURRENT_MINUTE
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	time_sync_poll() is called once per main loop. The
+	*											local clock is can_time_us() (can_health.c).
+	*
+	*	NOTES:	TIME_SYNC:	[4] = sequence, [3:0] = mission seconds (MSB first).
+	*			TIME_FUP:	[4] = sequence, [3:0] = microseconds after those seconds at which the
+	*						TIME_SYNC was sent (MSB first, may be more than 1000000).
+	*
+	*			The OBC should stamp the TIME_SYNC on its transmit interrupt, at the same point of the
+	*			frame at which we capture CANSTM on reception. TIME_SYNC_DELAY_US is added otherwise.
+	*
+	*			Every sync puts the clock on the OBC's time, in between syncs the elapsed local time
+	*			is corrected by drift_ppm. Until the first sync the clock counts from reset and
+	*			CURRENT_MINUTE is left to SET_TIME.
+	*
+	*			A bus-off recovery or a bit rate switch restarts the CAN timer, can_time_carry() keeps
+	*			can_time_us() and with it the clock going from where it was.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+*/
+
+#include "time_sync.h"
+#include "can_api.h"
+
+static uint32_t mission_time_at(uint32_t local, uint16_t* us);
+static uint32_t get_u32(uint8_t* bytes);
+
+void time_sync_init(void)
+{
+	mclock.state = TIME_UNSYNCED;
+	mclock.fup_pending = 0;
+	mclock.base_local = can_time_us();
+	mclock.base_ms = 0;
+	mclock.base_us = 0;
+	mclock.drift_ppm = 0;
+	mclock.offset_us = 0;
+	mclock.syncs = 0;
+	mclock.missed = 0;
+	return;
+}
+
+/************************************************************************/
+/* MISSION TIME                                                         */
+/*																		*/
+/* Returns the mission time in ms, and the microseconds within that ms	*/
+/* in *us (if us is not 0).												*/
+/************************************************************************/
+
+uint32_t mission_time(uint16_t* us)
+{
+	uint16_t sub_ms;
+	uint32_t ms;
+	
+	ms = mission_time_at(can_time_us(), &sub_ms);
+	if(us)
+		*us = sub_ms;
+	return ms;
+}
+
+/************************************************************************/
+/* TIME SYNC POLL                                                       */
+/*																		*/
+/* Gives up on a TIME_FUP which did not arrive, and moves the base of	*/
+/* the clock forward every TIME_REBASE_US.								*/
+/************************************************************************/
+
+void time_sync_poll(void)
+{
+	uint32_t now = can_time_us();
+	
+	if(mclock.fup_pending && ((now - mclock.sync_local) > TIME_FUP_TIMEOUT_US))
+	{
+		mclock.fup_pending = 0;
+		if(mclock.missed < 0xFF)
+			mclock.missed++;
+	}
+	if((now - mclock.base_local) < TIME_REBASE_US)
+		return;
+	mclock.base_ms = mission_time_at(now, &mclock.base_us);
+	mclock.base_local = now;
+	if(mclock.state == TIME_SYNCED)
+		CURRENT_MINUTE = (uint8_t)(mclock.base_ms / 60000);
+	return;
+}
+
+/************************************************************************/
+/* TIME SYNC RECEIVED                                                   */
+/*																		*/
+/* Handler for TIME_SYNC, remembers when it arrived (can_rx_time).		*/
+/************************************************************************/
+
+void time_sync_received(uint8_t* command)
+{
+	if(mclock.fup_pending && (mclock.missed < 0xFF))
+		mclock.missed++;
+	mclock.seq = *(command + 4);
+	mclock.sync_sec = get_u32(command);
+	mclock.sync_local = can_rx_time;
+	mclock.fup_pending = 1;
+	return;
+}
+
+/************************************************************************/
+/* TIME FUP RECEIVED                                                    */
+/*																		*/
+/* Handler for TIME_FUP. Measures the offset and the drift of our clock	*/
+/* and puts it on the OBC's time as of the TIME_SYNC.					*/
+/************************************************************************/
+
+void time_fup_received(uint8_t* command)
+{
+	uint32_t fup_us, master, master_ms, est_ms, local_delta;
+	uint16_t master_us, est_us;
+	int32_t offset, error, drift;
+	
+	if(!mclock.fup_pending || (*(command + 4) != mclock.seq))
+		return;								// Stale, the TIME_SYNC is counted as missed.
+	mclock.fup_pending = 0;
+	fup_us = get_u32(command) + TIME_SYNC_DELAY_US;
+	master = mclock.sync_sec * 1000000 + fup_us;	// Wraps, only used for differences.
+	master_ms = mclock.sync_sec * 1000 + fup_us / 1000;
+	master_us = fup_us % 1000;
+	
+	if(mclock.state == TIME_SYNCED)
+	{
+		est_ms = mission_time_at(mclock.sync_local, &est_us);
+		offset = (int32_t)(master_ms - est_ms);
+		if(offset > 32)						// Saturate before converting to us.
+			offset = 32;
+		if(offset < -32)
+			offset = -32;
+		offset = offset * 1000 + master_us - est_us;
+		if(offset > 32767)
+			offset = 32767;
+		if(offset < -32767)
+			offset = -32767;
+		mclock.offset_us = (int16_t)offset;
+		
+		local_delta = mclock.sync_local - mclock.prev_local;
+		error = (int32_t)((master - mclock.prev_master) - local_delta);
+		if((local_delta >= 1000000) && (error < 2000000) && (error > -2000000))
+		{
+			drift = (error * 1000) / (int32_t)(local_delta / 1000);
+			if((drift <= TIME_DRIFT_MAX_PPM) && (drift >= -TIME_DRIFT_MAX_PPM))
+			{
+				error = (drift - mclock.drift_ppm) / 4;		// Smooth out the jitter of single syncs,
+				if(!error)									// but still settle on the last ppm.
+					error = (drift > mclock.drift_ppm) - (drift < mclock.drift_ppm);
+				mclock.drift_ppm += (int16_t)error;
+			}
+		}
+	}
+	
+	mclock.base_local = mclock.sync_local;
+	mclock.base_ms = master_ms;
+	mclock.base_us = master_us;
+	mclock.prev_local = mclock.sync_local;
+	mclock.prev_master = master;
+	mclock.state = TIME_SYNCED;
+	mclock.syncs++;
+	CURRENT_MINUTE = (uint8_t)(master_ms / 60000);
+	return;
+}
+
+/************************************************************************/
+/* MISSION TIME AT                                                      */
+/*																		*/
+/* Converts a can_time_us() value to mission time. The value may be a	*/
+/* little older than base_local (a frame stamped before a rebase).		*/
+/* elapsed / 16 * drift_ppm fits in 32 bits for up to ~34 s.			*/
+/************************************************************************/
+
+static uint32_t mission_time_at(uint32_t local, uint16_t* us)
+{
+	int32_t elapsed, total;
+	uint32_t ms, borrow;
+	
+	elapsed = (int32_t)(local - mclock.base_local);
+	total = elapsed + ((elapsed / 16) * mclock.drift_ppm) / 62500 + mclock.base_us;
+	ms = mclock.base_ms;
+	if(total < 0)
+	{
+		borrow = ((uint32_t)(-total) + 999) / 1000;
+		ms -= borrow;
+		total += (int32_t)(borrow * 1000);
+	}
+	*us = (uint16_t)(total % 1000);
+	return ms + total / 1000;
+}
+
+static uint32_t get_u32(uint8_t* bytes)
+{
+	return ((uint32_t)*(bytes + 3) << 24) | ((uint32_t)*(bytes + 2) << 16) | ((uint32_t)*(bytes + 1) << 8) | *(bytes);
+}
@@ -0,0 +1,38 @@
+/*
+	***********************************************************************
+	*	FILE NAME:		time_sync.h
+	*
+	*	PURPOSE:	This program contains the prototypes for time_sync.c
+	*
+	*	FILE REFERENCES:	global_var.h
+	*
+	*	EXTERNAL VARIABLES:	
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None so far.
+	*
+	*	DEVELOPMENT HISTORY:
+	*	10/16/2026			Created.
+	*
+*/
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include "global_var.h"
+
+void time_sync_init(void);
+void time_sync_poll(void);
+void time_sync_received(uint8_t* command);
+void time_fup_received(uint8_t* command);
+uint32_t mission_time(uint16_t* us);
+
+#endif
@@ -154,169 +154,521 @@
 	*	01/20/2015		Getting rid of functions that we don't really need anymore.
 	*
 	*	02/04/2016		I was able to send a 76B packet from one SSM to another using the CC1120 tranceivers.
+	*
+	*	10/16/2026		Added dir_FIFO_write_burst() and FIFO_read_burst() which use the burst bit (0x40) of
+	*					the CC1120 header byte to move a whole packet through the FIFO in a single CSn window.
+	*					Previously every byte cost an SNOP strobe, a 1 us delay and three SPI bytes.
+	*					transceiver_send(), prepareAck(), prepareAnt(), load_packet() and load_ack() now use them.
+	*					prepareAck() and prepareAnt() share prepare_reply().
+	*
+	*	10/17/2026		transceiver_run() is now a state machine (TRANS_LISTEN, TRANS_TURNAROUND, TRANS_TX).
+	*					GPIO0 is set to PKT_SYNC_RXTX and its falling edge (end of packet) is caught with a
+	*					pin-change interrupt, so a TC is read and acknowledged as soon as it arrives instead
+	*					of on the next 250 ms cycle. The delay_ms(200) "relic" is gone; the poll fallback
+	*					now waits for GPIO0 to be low instead. The ACK_TIMEOUT back-off no longer blocks.
+	*					Fixed the uninitialized state / CHIP_RDYn pointers.
+	*
+	*	10/17/2026		packet_list[] is now a circular queue (tc_head, packet_count) of TC_QUEUE_DEPTH
+	*					packets. current_tc points at the oldest TC instead of being a copy of it, and
+	*					release_current_tc() frees the slot in O(1) instead of shifting the whole list.
+	*
+	*	10/17/2026		fletcher16() moved to checksum.c.
+	*
+	*	10/17/2026		The register settings are now the PROGMEM table cc1120_config[]. reg_settings() writes
+	*					it in bursts and reg_settings_check() reads it back and compares CRC-16s. Every
+	*					CALIBRATION_TIMEOUT the chip is only reset and reloaded if the check fails, otherwise
+	*					it just gets an SCAL. The fixed 100/250/250 ms waits in transceiver_initialize() now
+	*					poll the status byte until the CC1120 is back in IDLE.
+	*
+	*	10/17/2026		uhf_shadow[] holds what every register in cc1120_config[] should contain. reg_write(),
+	*					reg_write2F() keep it up to date and reg_write_bit() / reg_write_bit2F() take the old
+	*					value from it instead of reading the chip. reg_scrub() replaces reg_settings_check():
+	*					it compares the chip with the shadow register by register (so a deliberate change
+	*					such as OOK for the beacon is not mistaken for an upset), rewrites the ones which
+	*					were hit and only asks for a reset if that doesn't stick.
+	*
+	*	10/17/2026		TMs now go down through the sliding window in dl_arq.c instead of transmit_packet(),
+	*					which resent tm_to_downlink[] every TRANSMIT_TIMEOUT until an ACK came back. Up to
+	*					DL_WINDOW frames are in flight, each behind a sequence number byte, and the ground
+	*					can acknowledge them selectively (DL_ACK_TAG). A plain "ACK" still works.
+	*
+	*	10/17/2026		Whole 152-byte packets now cross the link in FRAG_COUNT fragments (frag.c) instead of
+	*					only bytes 151-76. store_new_packet() reassembles TCs in the tail slot of packet_list[]
+	*					and keeps the PEC sent by the ground instead of computing one over a zero-filled
+	*					lower half. The 0x18 written over B151 of every TM is gone.
+	*
+	*	10/17/2026		PKT_CFG1 now turns on APPEND_STATUS (the CRC setting is unchanged, it is part of the
+	*					air interface). rf_link_record() keeps the last,
+	*					min, max and average RSSI, LQI and frequency offset estimate of every packet received,
+	*					and counts packets flushed by the CC1120 (rf_rejected).
+	*
+	*	10/17/2026		The transceiver is no longer calibrated every CALIBRATION_TIMEOUT regardless. That is
+	*					now only how often uhf_cal_check() looks for a reason to (temperature, frequency offset
+	*					drift, RX/TX errors, failed transmissions, register upsets, CAL_MAX_INTERVAL), and
+	*					uhf_calibrate() waits until no packet exchange is in progress.
+	*
+	*	10/17/2026		The TRANSCEIVER_CYCLE fallback, calibration and TM transmission check GPIO0 through the
+	*					CC1120's GPIO_STATUS register (uhf_rx_active()) instead of reading PD7, so the radio
+	*					keeps working (with up to TRANSCEIVER_CYCLE of latency) if GPIO0 isn't on PD7.
+	*
+	*	10/17/2026		Under TC_DROP_OLDEST, store_new_packet() checks the fragment header (frag_check())
+	*					before dropping the oldest TC, a bad header used to cost a queued TC.
 */
 
 #include "trans_lib.h"
+#include <avr/pgmspace.h>
 
 #if (SELF_ID == 0)
 
 static void send_can_value(uint8_t* data);
-static void clear_current_tc(void);
+static void prepare_reply(char* text);
+static void uhf_burst_end(void);
+static void reg_burst_start(uint8_t flags, uint8_t addr, uint8_t read);
+static uint8_t uhf_wait_idle(uint8_t timeout_ms);
+static uint8_t reg_burst_all(uint8_t mode);
+static uint8_t reg_shadow_find(uint8_t ext, uint8_t addr);
+static void reg_shadow_update(uint8_t ext, uint8_t addr, uint8_t data);
+static void trans_receive(uint8_t event);
+static uint8_t uhf_rx_active(void);
+static void uhf_cal_check(void);
+static uint8_t uhf_link_quiet(void);
+static void uhf_calibrate(void);
+static void rf_link_record(uint8_t loaded);
+static void rf_stat_add(rf_stat* s, int16_t sample);
+static void trans_tx_done(void);
+
+/* Settings taken from SmartRF, sorted by address so that runs can be burst-written.
+ * SYNC_CFG1, MDMCFG1, MDMCFG0 and TOC_CFG used to be set with reg_write_bit() on top
+ * of the reset values, the table holds the resulting values. */
+static const cc1120_reg cc1120_config[] PROGMEM =
+{
+	{0,				IOCFG0,			0x06},		// GPIO0 = PKT_SYNC_RXTX (low at the end of every packet)
+	{0,				SYNC3,			0x93},		// SYNC word bits 31:24
+	{0,				SYNC2,			0x0B},		// SYNC word bits 23:16
+	{0,				SYNC1,			0x51},		// SYNC word bits 15:8
+	{0,				SYNC0,			0xDE},		// SYNC word bits 7:0
+	{0,				SYNC_CFG1,		0x4B},		// 0x0B from SmartRF + PQT_GATING_EN
+	{0,				SYNC_CFG0,		0x17},		// 32 bit SYNC word. Bit error qualifier disabled.
+	{0,				DEVIATION_M,	0x48},		// DEV_M = 72, 20.019531kHz deviation (with DEV_E = 5)
+	{0,				MODCFG_DEV_E,	0x05},		// Modulation mode and DEV_E = 5
+	{0,				DCFILT_CFG,		0x1C},
+	{0,				PREAMBLE_CFG1,	0x14},
+	{0,				PREAMBLE_CFG0,	0x2A},
+	{0,				IQIC,			0x00},
+	{0,				CHAN_BW,		0x04},
+	{0,				MDMCFG1,		0x46},		// FIFO_EN
+	{0,				MDMCFG0,		0x05},		// Transparent mode disabled
+	{0,				SYMBOL_RATE2,	0x73},
+	{0,				AGC_CFG1,		0xA9},
+	{0,				AGC_CFG0,		0xCF},
+	{0,				FIFO_CFG,		0xFF},
+	{0,				DEV_ADDR,		DEVICE_ADDRESS},
+	{0,				SETTLING_CFG,	0x03},
+	{0,				FS_CFG,			0x14},		// LO divider 8 (410.0 - 480.0 MHz band), out of lock detector disabled
+	{0,				PKT_CFG2,		0x00},		// FIFO mode
+	{0,				PKT_CFG1,		0x31},		// Address check and 0xFF broadcast, append RSSI/LQI
+	{0,				PKT_CFG0,		0x20},		// Variable packet length
+	{0,				RFEND_CFG1,		0x2E},		// Go to TX after a good packet, RX timeout disabled.
+	{0,				RFEND_CFG0,		0x30},		// Go to RX after transmitting a packet
+	{0,				PA_CFG2,		0x7F},		// POWER_RAMP = 64 (14.5dBm, equation 21)
+	{0,				PKT_LEN,		0xFF},
+	{CC_EXT,		IF_MIX_CFG,		0x00},
+	{CC_EXT,		TOC_CFG,		0x0B},		// TOC_LIMIT = 0 (low tolerance, shorter settling)
+	{CC_EXT|CC_NO_VERIFY,	FREQOFF1,	0x00},	// Frequency offset, SAFC changes it.
+	{CC_EXT|CC_NO_VERIFY,	FREQOFF0,	0x00},
+	{CC_EXT,		FREQ2,			0x6C},		// 434MHz
+	{CC_EXT,		FREQ1,			0x80},
+	{CC_EXT,		FREQ0,			0x00},
+	{CC_EXT,		FS_DIG1,		0x00},		// High performance settings
+	{CC_EXT,		FS_DIG0,		0x5F},
+	{CC_EXT,		FS_CAL1,		0x40},
+	{CC_EXT,		FS_CAL0,		0x0E},
+	{CC_EXT,		FS_DIVTWO,		0x03},
+	{CC_EXT,		FS_DSM0,		0x33},
+	{CC_EXT,		FS_DVC0,		0x17},
+	{CC_EXT,		FS_PFD,			0x50},
+	{CC_EXT,		FS_PRE,			0x6E},
+	{CC_EXT,		FS_REG_DIV_CML,	0x14},
+	{CC_EXT,		FS_SPARE,		0xAC},
+	{CC_EXT,		FS_VCO0,		0xB4},
+	{CC_EXT,		XOSC5,			0x0E},
+	{CC_EXT,		XOSC1,			0x03},
+};
+typedef char cc1120_config_size_check[(sizeof(cc1120_config) / sizeof(cc1120_reg) == CC1120_CONFIG_SIZE) ? 1 : -1];
 
 void transceiver_initialize(void)
 {	
 	/* SPI is already in MSB first, which is correct for the CC1120. */
 	SS_set_low();
     cmd_str(SRES);		//SRES			reset chip
-	delay_ms(100);
+	uhf_wait_idle(100);
     cmd_str(SFRX);		//SFRX          flush RX FIFO
     cmd_str(SFTX);      //SFTX          flush TX FIFO
 	/* Settings taken from SmartRF */
 	reg_settings();
 	/* Calibrate */
 	cmd_str(SCAL);                   // Calibrate frequency synthesizer
-	delay_ms(250);
+	uhf_wait_idle(250);
 	cmd_str(SAFC);					 // Automatic frequency control
-	delay_ms(250);
+	uhf_wait_idle(250);
 
-	rx_mode = 1;
-	tx_mode = 0;
 	rx_length = 0;
 	prepareAck();
 	/* Put In RX Mode */
 	cmd_str(SRX);
+	rx_mode = 1;
+	tx_mode = 0;
+	/* End of packet on GPIO0 -> PCINT */
+	trans_irqf = 0;
+	trans_reply = 0;
+	trans_state = TRANS_LISTEN;
+	PORTD |= (1 << UHF_GPIO_BIT);		// Pull-up, so an unconnected pin can't raise false edges.
+	PCMSK2 |= (1 << UHF_GPIO_BIT);
+	PCICR |= (1 << PCIE2);
 	return;	
 }
 
+/************************************************************************/
+/*	TRANSCEIVER_RUN                                                     */
+/*																		*/
+/*	State machine for the CC1120, called from the main loop on every	*/
+/*	pass. GPIO0 is configured as PKT_SYNC_RXTX so the end of every		*/
+/*	packet (received, sent or aborted) raises trans_irqf via			*/
+/*	PCINT2_vect and is handled straight away. The once-per-				*/
+/*	TRANSCEIVER_CYCLE poll only remains as a fallback for a missed		*/
+/*	edge and for the timed jobs (error recovery, calibration, TM).		*/
+/*																		*/
+/************************************************************************/
 void transceiver_run(void)
 {
-	uint8_t *state, *CHIP_RDYn, rxFirst, rxLast, check;
-	*state = 0;
-	*CHIP_RDYn = 0;
-	if (millis() - lastCycle < TRANSCEIVER_CYCLE)
-		return;
-	
-	if(tx_mode)
+	uint8_t event, sreg, CHIP_RDYn, state;
+
+	sreg = SREG;
+	cli();
+	event = trans_irqf;
+	trans_irqf = 0;
+	SREG = sreg;
+
+	switch(trans_state)
 	{
-		rx_mode = 0;
-		tx_length = reg_read2F(NUM_TXBYTES);
-		if(tx_length)
-		{
-			if(tx_fail_count)
-			{
-				cmd_str(SIDLE);
-				cmd_str(SFTX);
-				cmd_str(SRX);
-				rx_mode = 1;
-				tx_mode = 0;
-				tx_fail_count = 0;
-				lastCycle = millis();
-				return;
-			}
-			else
-			{
-				cmd_str(STX);
-				tx_fail_count++;
-			}
-		}
-		else
-		{
-			cmd_str(SRX);
-			rx_mode = 1;
-			tx_mode = 0;
-			lastCycle = millis();
-			return;
-		}
+		case TRANS_LISTEN:
+			// Without an edge, only look at the FIFO once a packet is no longer arriving.
+			if(event || ((millis() - lastCycle >= TRANSCEIVER_CYCLE) && !uhf_rx_active()))
+				trans_receive(event);
+			break;
+		case TRANS_TURNAROUND:
+		case TRANS_TX:
+			if(event || (millis() - trans_timer > TRANS_TX_TIMEOUT))
+				trans_tx_done();
+			break;
+		default:
+			trans_state = TRANS_LISTEN;
+			break;
 	}
-	if(rx_mode)
+
+	if (millis() - lastCycle < TRANSCEIVER_CYCLE)
+		return;
+
+	if(trans_state == TRANS_LISTEN)
 	{
-		tx_mode = 0;
-		rx_length = reg_read2F(NUM_RXBYTES);
-		rxFirst = reg_read2F(RXFIRST);
-		rxLast = reg_read2F(RXLAST);
-		/* Got some data */
-		if(rx_length)
-		{
-			delay_ms(200);		// Relic of working code.
-			if(rx_length > REAL_PACKET_LENGTH)
-			{
-				//uart_printf("PACKET RECEIVED\n\r");
-				load_packet();
-				/* We have a packet */
-				if(new_packet[0] <= (rxLast - rxFirst + 1))		// Length = data + address byte + length byte
-				{
-					//PIN_toggle(LED3);
-					check = store_new_packet();
-					rx_length = 0;
-					if(!check)									// Packet was accepted and stored internally.
-					{
-						if(alert_deployf)
-							prepareAnt();
-						else
-							prepareAck();
-						cmd_str(STX);
-						return;
-					}
-
-				}
-			}
-			else if(rx_length > ACK_LENGTH)
-			{
-				load_ack();
-
-				/* We have an acknowledgment */
-				if(new_packet[2] == 0x41 && new_packet[3] == 0x43 && new_packet[4] == 0x4B)	// Received proper acknowledgment.
-				{
-					lastAck = millis();
-					lastTransmit = millis();
-					//if(last_tx_packet_height)
-					current_tm_fullf = 0;				// Second half of packet was sent, set current_tm_fullf to zero.
-					//ack_acquired = 1;
-				}
-				/* We have an acknowledgment */
-				if(new_packet[2] == 0x41 && new_packet[3] == 0x4E && new_packet[4] == 0x54)	// Received proper acknowledgment.
-				{
-					alert_deployf = 10;
-					alert_deploy();
-				}
-			}
-			cmd_str(SIDLE);			// Need to get rid of this.
-			cmd_str(SFRX);
-			cmd_str(SRX);				
-		}
-		get_status(CHIP_RDYn, state);
-		if(*state == 0b110)
+		get_status(&CHIP_RDYn, &state);
+		if((state == STATERXERR) || (state == STATETXERR))
 		{
 			cmd_str(SIDLE);
 			cmd_str(SFRX);
-			//cmd_str(SRX);
+			cmd_str(SFTX);
+			uhf_cal_pending |= CAL_RXERR;
 		}
 		cmd_str(SRX);			// Make sure we're in RXSTATE while in rx-mode.
 	}
 	if(millis() - lastAck > ACK_TIMEOUT)
 	{
-		delay_ms((uint8_t)rand());
+		lastTransmit += (uint8_t)rand();		// Random back-off before the next TM.
 		lastAck = millis();
 	}
-	if(millis() - lastCalibration > CALIBRATION_TIMEOUT)	// Calibrate the transceiver.
+	if(millis() - lastCalCheck > CALIBRATION_TIMEOUT)		// Should the transceiver be calibrated?
+	{
+		uhf_cal_check();
+		lastCalCheck = millis();
+	}
+	if(uhf_cal_pending && (trans_state == TRANS_LISTEN) && !uhf_rx_active() && uhf_link_quiet())
+		uhf_calibrate();
+	if((trans_state == TRANS_LISTEN) && ((long int)(millis() - lastTransmit) >= dl_gap) && !uhf_rx_active())	// Transmit a TM frame (if one is due)
 	{
+		if(dl_arq_transmit())
+			lastTransmit = millis();
+	}
+	lastCycle = millis();
+}
+
+/************************************************************************/
+/*	UHF_CAL_CHECK                                                       */
+/*																		*/
+/*	Called every CALIBRATION_TIMEOUT. Looks for reasons to calibrate	*/
+/*	the synthesizer and adds them to uhf_cal_pending (RX/TX errors and	*/
+/*	failed transmissions are added as they happen):						*/
+/*	- COMS temperature (coms_temp) moved by CAL_TEMP_DELTA				*/
+/*	- the average FREQOFF_EST moved by CAL_FREQOFF_DELTA				*/
+/*	- a register no longer matches uhf_shadow[] (read only, in RX)		*/
+/*	- nothing else for CAL_MAX_INTERVAL									*/
+/*	Drift is only acted on every CAL_MIN_INTERVAL, Doppler alone can	*/
+/*	move FREQOFF_EST by that much during a pass.						*/
+/*																		*/
+/************************************************************************/
+static void uhf_cal_check(void)
+{
+	int16_t freqoff, diff;
+
+	if(!uhf_cal_temp)
+		uhf_cal_temp = coms_temp;				// First reading since the last calibration.
+	if(millis() - lastCalibration > CAL_MIN_INTERVAL)
+	{
+		diff = (int16_t)coms_temp - (int16_t)uhf_cal_temp;
+		if(uhf_cal_temp && ((diff >= CAL_TEMP_DELTA) || (diff <= -CAL_TEMP_DELTA)))
+			uhf_cal_pending |= CAL_TEMP;
+		freqoff = (int16_t)(rf_freqoff.avg8 >> 3);
+		diff = freqoff - uhf_cal_freqoff;
+		if((rf_frames != uhf_cal_frames) && ((diff >= CAL_FREQOFF_DELTA) || (diff <= -CAL_FREQOFF_DELTA)))
+			uhf_cal_pending |= CAL_FREQOFF;
+	}
+	if(reg_burst_all(CC_BURST_READ))
+		uhf_cal_pending |= CAL_UPSET;
+	if(millis() - lastCalibration > CAL_MAX_INTERVAL)
+		uhf_cal_pending |= CAL_AGE;
+	return;
+}
+
+// Helper: no packet is arriving, due for an ACK or halfway through being reassembled.
+static uint8_t uhf_link_quiet(void)
+{
+	if((long int)(millis() - lastReceive) < CAL_QUIET)
+		return 0;
+	if((long int)(millis() - lastTransmit) < (long int)dl_rto)
+		return 0;
+	if(rx_frag_have && ((millis() - rx_frag_started) <= FRAG_TIMEOUT))
+		return 0;
+	return 1;
+}
+
+/************************************************************************/
+/*	UHF_CALIBRATE                                                       */
+/*																		*/
+/*	Repairs the registers if needed and calibrates the synthesizer		*/
+/*	with SCAL (a few hundred us). The chip is only reset and reloaded	*/
+/*	if the registers can't be repaired.									*/
+/*																		*/
+/************************************************************************/
+static void uhf_calibrate(void)
+{
+	cmd_str(SIDLE);
+	uhf_wait_idle(10);
+	if(reg_scrub() != 0xFF)
+	{
+		/* Registers are intact (or were repaired), only the synthesizer needs calibrating */
+		cmd_str(SCAL);
+		uhf_wait_idle(250);
+		cmd_str(SRX);
+	}
+	else
+	{
+		uhf_reinits++;
 		PIN_clr(UHF_RST);
 		delay_ms(250);
 		PIN_set(UHF_RST);
 		transceiver_initialize();
-		lastCalibration = millis();
 	}
-	if(millis() - lastTransmit > TRANSMIT_TIMEOUT)	// Transmit packet (if one is available)
+	uhf_cals++;
+	uhf_cal_reasons |= uhf_cal_pending;
+	uhf_cal_pending = 0;
+	uhf_cal_temp = coms_temp;
+	uhf_cal_freqoff = (int16_t)(rf_freqoff.avg8 >> 3);
+	uhf_cal_frames = rf_frames;
+	lastCalibration = millis();
+	return;
+}
+
+/************************************************************************/
+/*	TRANS_RECEIVE                                                       */
+/*																		*/
+/*	Reads whatever is in the RX FIFO at the end of a packet. A TC is	*/
+/*	stored and answered with ACK/ANT, an ACK from the ground releases	*/
+/*	the current TM. RFEND_CFG1 puts the CC1120 into TX after a good		*/
+/*	packet, so we wait in TRANS_TURNAROUND before using any strobes.	*/
+/*	An end of packet (event) with nothing in the FIFO means the packet	*/
+/*	was flushed for a wrong address.									*/
+/*																		*/
+/************************************************************************/
+static void trans_receive(uint8_t event)
+{
+	uint8_t rxFirst, rxLast;
+
+	rx_length = reg_read2F(NUM_RXBYTES);
+	if(!rx_length)
+	{
+		if(event)
+			rf_rejected++;
+		return;
+	}
+	lastReceive = millis();
+	rxFirst = reg_read2F(RXFIRST);
+	rxLast = reg_read2F(RXLAST);
+	trans_reply = 0;
+
+	if(rx_length > REAL_PACKET_LENGTH)
+	{
+		//uart_printf("PACKET RECEIVED\n\r");
+		load_packet();
+		rf_link_record(REAL_PACKET_LENGTH + 2 + UHF_STATUS_LENGTH);
+		/* We have a packet */
+		if(new_packet[0] <= (rxLast - rxFirst + 1))		// Length = data + address byte + length byte
+		{
+			//PIN_toggle(LED3);
+			if(!store_new_packet())						// Packet was accepted and stored internally.
+				trans_reply = 1;
+		}
+	}
+	else if(rx_length > ACK_LENGTH)
+	{
+		load_ack();
+		rf_link_record(ACK_LENGTH + 2 + UHF_STATUS_LENGTH);
+
+		/* We have an acknowledgment */
+		if((new_packet[2] == DL_ACK_TAG) || (new_packet[2] == 0x41 && new_packet[3] == 0x43 && new_packet[4] == 0x4B))
+		{
+			lastAck = millis();
+			dl_ack_received(new_packet + 2);	// Slides the downlink window.
+		}
+		/* We have an acknowledgment */
+		if(new_packet[2] == 0x41 && new_packet[3] == 0x4E && new_packet[4] == 0x54)	// Received proper acknowledgment.
+		{
+			alert_deployf = 10;
+			alert_deploy();
+		}
+	}
+	rx_length = 0;
+	trans_state = TRANS_TURNAROUND;
+	trans_timer = millis();
+	return;
+}
+
+/************************************************************************/
+/*	RF_LINK_RECORD                                                      */
+/*																		*/
+/*	Adds the RSSI and LQI appended to the packet in new_packet[] (the	*/
+/*	first 'loaded' bytes of the FIFO) and the frequency offset			*/
+/*	estimated by the CC1120 to the link statistics.						*/
+/*																		*/
+/************************************************************************/
+static void rf_link_record(uint8_t loaded)
+{
+	uint8_t* status = new_packet + new_packet[0] + 1;	// Length byte + address + data.
+	int16_t freqoff;
+
+	if((new_packet[0] + 1 + UHF_STATUS_LENGTH) > loaded)
+		return;											// Longer than what was read.
+	freqoff = (int16_t)(((uint16_t)reg_read2F(FREQOFF_EST1) << 8) | reg_read2F(FREQOFF_EST0));
+	rf_frames++;
+	rf_stat_add(&rf_rssi, (int8_t)status[0]);
+	rf_stat_add(&rf_lqi, status[1] & 0x7F);
+	rf_stat_add(&rf_freqoff, freqoff);
+	return;
+}
+
+// Helper: rf_frames has already been incremented, so 1 = first sample.
+static void rf_stat_add(rf_stat* s, int16_t sample)
+{
+	s->last = sample;
+	if(sample < s->min)
+		s->min = sample;
+	if(sample > s->max)
+		s->max = sample;
+	if(rf_frames == 1)
+		s->avg8 = (int32_t)sample << 3;
+	else
+		s->avg8 += sample - (s->avg8 >> 3);			// EWMA, weight 1/8.
+	return;
+}
+
+// Starts a new min / max period for the link statistics (min > max = no packet yet).
+void rf_link_reset(void)
+{
+	rf_rssi.min = rf_lqi.min = rf_freqoff.min = INT16_MAX;
+	rf_rssi.max = rf_lqi.max = rf_freqoff.max = INT16_MIN;
+	return;
+}
+
+/************************************************************************/
+/*	TRANS_TX_DONE                                                       */
+/*																		*/
+/*	Called at the end of a transmission (or when TRANS_TX_TIMEOUT		*/
+/*	runs out). After a turnaround the RX FIFO is flushed and the reply	*/
+/*	to an accepted TC is sent, otherwise we go back to listening. A		*/
+/*	packet still sitting in the TX FIFO is retried once.				*/
+/*																		*/
+/************************************************************************/
+static void trans_tx_done(void)
+{
+	if(trans_state == TRANS_TURNAROUND)
 	{
-		//PIN_toggle(LED3);
 		cmd_str(SIDLE);
 		cmd_str(SFRX);
-		cmd_str(SFTX);
-		delay_ms(5);
-		transmit_packet();
-		lastTransmit = millis();
+		if(trans_reply)
+		{
+			trans_reply = 0;
+			if(alert_deployf)
+				prepareAnt();
+			else
+				prepareAck();
+			cmd_str(STX);
+			trans_state = TRANS_TX;
+			trans_timer = millis();
+			return;
+		}
 	}
-	lastCycle = millis();
+	else
+	{
+		tx_length = reg_read2F(NUM_TXBYTES);
+		if(tx_length)
+		{
+			if(!tx_fail_count)
+			{
+				cmd_str(STX);
+				tx_fail_count++;
+				trans_timer = millis();
+				return;
+			}
+			cmd_str(SIDLE);
+			cmd_str(SFTX);
+			uhf_cal_pending |= CAL_TXFAIL;
+		}
+		tx_fail_count = 0;
+	}
+	cmd_str(SRX);
+	rx_mode = 1;
+	tx_mode = 0;
+	trans_state = TRANS_LISTEN;
+	return;
+}
+
+// Helper: 1 while a packet is being received or sent (PKT_SYNC_RXTX). Read back from the CC1120's
+// GPIO_STATUS rather than from the GPIO0 pin, so the timed jobs don't depend on how it is wired.
+static uint8_t uhf_rx_active(void)
+{
+	return reg_read2F(GPIO_STATUS) & 0x01;
+}
+
+/************************************************************************/
+/*	UHF GPIO0 INTERRUPT                                                 */
+/*																		*/
+/*	GPIO0 (PKT_SYNC_RXTX) goes high on a sync word and low at the end	*/
+/*	of the packet. Only the falling edge is latched, the SPI work is	*/
+/*	left to transceiver_run().											*/
+/*																		*/
+/************************************************************************/
+ISR(PCINT2_vect)
+{
+	if(!UHF_GPIO_HIGH())
+		trans_irqf = 1;
 }
 
 static void send_can_value(uint8_t* data)
@@ -333,94 +685,148 @@ static void send_can_value(uint8_t* data)
 	return;
 }
 
+/************************************************************************/
+/*	REG_SETTINGS                                                        */
+/*																		*/
+/*	Loads cc1120_config[] into uhf_shadow[] and writes it to the		*/
+/*	CC1120. Consecutive addresses in the same register space go out		*/
+/*	as one burst.														*/
+/*																		*/
+/************************************************************************/
 void reg_settings(void)
 {
-	//high performance settings
-	reg_write2F(FS_DIG1, 0x00);				//FS_DIG1: 0x00         Frequency Synthesizer Digital Reg. 1
-	reg_write2F(FS_DIG0, 0x5F);				//FS_DIG0: 0x5F         Frequency Synthesizer Digital Reg. 0
-	reg_write2F(FS_CAL1, 0x40);				//FS_CAL1: 0x40         Frequency Synthesizer Calibration Reg. 1
-	reg_write2F(FS_CAL0, 0x0E);				//FS_CAL0: 0x0E         Frequency Synthesizer Calibration Reg. 0
-	reg_write2F(FS_DIVTWO, 0x03);			//FS_DIVTWO: 0x03       Frequency Synthesizer Divide by 2
-	reg_write2F(FS_DSM0, 0x33);				//FS_DSM0: 0x33         FS Digital Synthesizer Module Configuration Reg. 0
-	reg_write2F(FS_DVC0, 0x17);				//FS_DVCO: 0x17         Frequency Synthesizer Divider Chain Configuration ..
-	reg_write2F(FS_PFD, 0x50);				//FS_PFD: 0x50          Frequency Synthesizer Phase Frequency Detector Con..
-	reg_write2F(FS_PRE, 0x6E);				//FS_PRE: 0x6E          Frequency Synthesizer Prescaler Configuration
-	reg_write2F(FS_REG_DIV_CML, 0x14);      //FS_REG_DIV_CML: 0x14  Frequency Synthesizer Divider Regulator Configurat..
-	reg_write2F(FS_SPARE, 0xAC);			//FS_SPARE: 0xAC        Set up Frequency Synthesizer Spare
-	reg_write2F(FS_VCO0, 0xB4);				//FS_VCO0: 0xB4         FS Voltage Controlled Oscillator Configuration Reg..
-	reg_write2F(XOSC5, 0x0E);				//XOSC5: 0x0E           Crystal Oscillator Configuration Reg. 5
-	reg_write2F(XOSC1, 0x03);				//XOSC1: 0x03           Crystal Oscillator Configuration Reg. 0
-	
-    /************************************/
-    //For test purposes only, (2nd block, deleted first one) use values from SmartRF for some bits
-    //High performance RX
-	cmd_str(SNOP);
-    reg_write(SYNC_CFG1, 0x0B);				//
-    reg_write(DCFILT_CFG, 0x1C);            //
-    reg_write(IQIC, 0x00);					//
-    reg_write(CHAN_BW, 0x04);				//
-    reg_write(MDMCFG0, 0x05);				//
-    reg_write(AGC_CFG1, 0xA9);				//
-    reg_write(AGC_CFG0, 0xCF);				//
-    reg_write(FIFO_CFG, 0xFF);				//
-    reg_write(SETTLING_CFG, 0x03);          //
-    reg_write2F(IF_MIX_CFG, 0x00);          //
-    /**************************************/
-	
-	//modulation and freq deviation settings
-	reg_write(DEVIATION_M, 0b01001000);     //DEVIATION_M: 0x48      set DEV_M to 72 which sets freq deviation to 20.019531kHz (with DEV_M=5)
-	reg_write(MODCFG_DEV_E, 0b00000101);    //MODCFG_DEV_E: 0x05     set up modulation mode and DEV_E to 5 (see DEV_M register)
-	reg_write(FS_CFG, 0b00010100);			//FS_CFG: B00010100      set up LO divider to 8 (410.0 - 480.0 MHz band), out of lock detector disabled
-	
-	//set preamble
-	//reg_write(PREAMBLE_CFG1, 0b00001101);         //PREAMBLE_CFG1: 0x00    No preamble
-	//reg_write_bit(PREAMBLE_CFG0, 5, 1);     //PQT_EN: 0x00           Preamble detection disabled
-	reg_write(PREAMBLE_CFG1, 0x14);
-	reg_write(PREAMBLE_CFG0, 0x2A);
-	reg_write(SYMBOL_RATE2, 0x73);
-	//reg_write(SYMBOL_RATE1, 0x05);
-	//reg_write(SYMBOL_RATE0, 0xBC);
-	
-	//TOC_LIMIT
-	reg_write_bit2F(TOC_CFG, 7, 0);			//TOC_LIMIT: 0x00      Using the low tolerance setting (TOC_LIMIT = 0) greatly reduces system settling times and system power consumption as no preamble bits are needed for bit synchronization or frequency offset compensation (4 bits preamble needed for AGC settling).
-	reg_write_bit2F(TOC_CFG, 6, 0);			//TOC_LIMIT: 0x00      Using the low tolerance setting (TOC_LIMIT = 0) greatly reduces system settling times and system power consumption as no preamble bits are needed for bit synchronization or frequency offset compensation (4 bits preamble needed for AGC settling).
-	
-	//set SYNC word
-	reg_write_bit(SYNC_CFG1, 6, 1);			//PQT_GATING_EN: 0       PQT gating disabled (preamble not required)
-	reg_write(SYNC_CFG0, 0x17);				//SYNC_CFG0: B00010111   32 bit SYNC word. Bit error qualifier disabled. No check on bit errors
-	reg_write(SYNC3, 0x93);					//SYNC3: 0x93            Set SYNC word bits 31:24
-	reg_write(SYNC2, 0x0B);					//SYNC2: 0x0B            Set SYNC word bits 23:16
-	reg_write(SYNC1, 0x51);					//SYNC1: 0x51            Set SYNC word bits 15:8
-	reg_write(SYNC0, 0xDE);					//SYNC0: 0xDE            Set SYNC word bits 7:0
-	
-	cmd_str(SNOP);
-	//set packets
-	reg_write_bit(MDMCFG1, 6, 1);			//FIFO_EN: 0             FIFO enable set to true
-	reg_write_bit(MDMCFG0, 6, 0);			//TRANSPARENT_MODE_EN: 0 Disable transparent mode
-	reg_write(PKT_CFG2, 0b00000000);		//PKT_CFG2: 0x00         set FIFO mode
-	reg_write(PKT_CFG1, 0b00110000);		//PKT_CFG1: 0x30         set address check and 0xFF broadcast
-	reg_write(PKT_CFG0, 0b00100000);		//PKT_CFG0: 0x30         set variable packet length
-	reg_write(PKT_LEN, 0xFF);				//PKT_LEN: 0xFF          set packet max packet length to 0x7F
-	reg_write(DEV_ADDR, DEVICE_ADDRESS);	//DEV_ADDR register is set to DEVICE_ADDRESS
-	reg_write(RFEND_CFG1, 0b00101110);      //RFEND_CFG1: 0x2E       go to TX after a good packet, RX timeout disabled.
-	//reg_write(0x29, 0b00111110);			//RFEND_CFG1: 0x3E       go to RX after a good packet
-	reg_write(RFEND_CFG0, 0b00110000);      //RFEND_CFG0: 0x30       go to RX after transmitting a packet
-	//reg_write(0x2A, 0b00100000);			//RFEND_CFG0: 0x20       go to TX after transmitting a packet
-	
-	//set power level
-	reg_write(PA_CFG2, 0b01111111);			//PA_CFG2: 0x7F          set POWER_RAMP to 64 (output power to 14.5dBm, equation 21)
-	
-	//frequency offset setting
-	reg_write2F(FREQOFF1, 0);				//FREQOFF1: 0x00         set frequency offset to 0
-	reg_write2F(FREQOFF0, 0);				//FREQOFF0: 0x00
-	
-	//Frequency setting
-	reg_write2F(FREQ2, 0x6C);				//FREQ2: 0x6C            set frequency to 434MHz (sets Vco, see equation from FREQ2 section of user guide)
-	reg_write2F(FREQ1, 0x80);				//FREQ1: 0x80
-	reg_write2F(FREQ0, 0x00);				//FREQ0: 0x00	
+	uint8_t i;
+
+	for(i = 0; i < CC1120_CONFIG_SIZE; i++)
+	{
+		uhf_shadow[i] = pgm_read_byte(&cc1120_config[i].value);
+	}
+	reg_burst_all(CC_BURST_WRITE);
 	return;
 }
 
+/************************************************************************/
+/*	REG_SCRUB                                                           */
+/*																		*/
+/*	Reads the configuration registers back and compares them with		*/
+/*	uhf_shadow[]. Registers which were upset (SEU, brown-out) are		*/
+/*	written again and counted in uhf_upsets. The CC1120 should be in	*/
+/*	IDLE.																*/
+/*	Returns the number of registers repaired, or 0xFF if the chip		*/
+/*	still does not match afterwards (it needs a reset).					*/
+/*																		*/
+/************************************************************************/
+uint8_t reg_scrub(void)
+{
+	uint8_t diff;
+
+	diff = reg_burst_all(CC_BURST_READ);
+	if(!diff)
+		return 0;
+	uhf_upsets += diff;
+	reg_burst_all(CC_BURST_REPAIR);
+	if(reg_burst_all(CC_BURST_READ))
+		return 0xFF;
+	return diff;
+}
+
+// Helper: goes through cc1120_config[] one burst per run of consecutive addresses.
+// CC_BURST_READ returns the number of registers which differ from uhf_shadow[].
+static uint8_t reg_burst_all(uint8_t mode)
+{
+	uint8_t i, flags, addr, value, open = 0, last_flags = 0, last_addr = 0, diff = 0;
+
+	for(i = 0; i < CC1120_CONFIG_SIZE; i++)
+	{
+		flags = pgm_read_byte(&cc1120_config[i].flags);
+		addr = pgm_read_byte(&cc1120_config[i].addr);
+		if((mode == CC_BURST_REPAIR) && (flags & CC_NO_VERIFY))
+		{
+			if(open)
+				uhf_burst_end();
+			open = 0;
+			continue;
+		}
+		if(!open || ((flags & CC_EXT) != (last_flags & CC_EXT)) || (addr != (uint8_t)(last_addr + 1)))
+		{
+			if(open)
+				uhf_burst_end();
+			reg_burst_start(flags, addr, (mode == CC_BURST_READ));
+			open = 1;
+		}
+		if(mode == CC_BURST_READ)
+		{
+			value = spi_transfer(0x00);
+			if(!(flags & CC_NO_VERIFY) && (value != uhf_shadow[i]))
+				diff++;
+		}
+		else
+			spi_transfer(uhf_shadow[i]);
+		last_flags = flags;
+		last_addr = addr;
+	}
+	if(open)
+		uhf_burst_end();
+	return diff;
+}
+
+// Helper: index of a register in cc1120_config[] / uhf_shadow[], 0xFF if it isn't there.
+static uint8_t reg_shadow_find(uint8_t ext, uint8_t addr)
+{
+	uint8_t i;
+
+	for(i = 0; i < CC1120_CONFIG_SIZE; i++)
+	{
+		if((pgm_read_byte(&cc1120_config[i].addr) == addr) && ((pgm_read_byte(&cc1120_config[i].flags) & CC_EXT) == ext))
+			return i;
+	}
+	return 0xFF;
+}
+
+// Helper: keeps uhf_shadow[] in step with single register writes.
+static void reg_shadow_update(uint8_t ext, uint8_t addr, uint8_t data)
+{
+	uint8_t i = reg_shadow_find(ext, addr);
+
+	if(i != 0xFF)
+		uhf_shadow[i] = data;
+	return;
+}
+
+// Helper: header byte(s) of a burst access starting at addr.
+static void reg_burst_start(uint8_t flags, uint8_t addr, uint8_t read)
+{
+	uint8_t header = 0b01000000;		// Burst bit.
+
+	if(read)
+		header |= 0b10000000;
+	SS_set_low();
+	if(flags & CC_EXT)
+	{
+		spi_transfer(header | 0x2F);
+		spi_transfer(addr);
+	}
+	else
+		spi_transfer(header | addr);
+	return;
+}
+
+// Helper: waits (up to timeout_ms) for the CC1120 to be ready and back in IDLE
+// after SRES, SCAL, SAFC or SIDLE. Returns 0 on a timeout.
+static uint8_t uhf_wait_idle(uint8_t timeout_ms)
+{
+	uint8_t CHIP_RDYn, state;
+
+	do
+	{
+		delay_ms(1);
+		get_status(&CHIP_RDYn, &state);
+		if(!CHIP_RDYn && (state == STATEIDLE))
+			return 1;
+	} while(--timeout_ms);
+	return 0;
+}
+
 uint8_t reg_read(uint8_t addr)
 {
 	uint8_t addr_new, msg;
@@ -440,6 +846,7 @@ void reg_write(uint8_t addr, uint8_t data)		// Doesn't need to return anything.
 	msg = spi_transfer(addr);		// Send the desired address
 	msg = spi_transfer(data);		// Send the desired data
 	SS_set_high();
+	reg_shadow_update(0, addr, data);
 	return;
 }
 
@@ -473,6 +880,7 @@ void reg_write2F(uint8_t addr, uint8_t data)		// Doesn't need to return anything
 	msg = spi_transfer(addr);		// Send the desired address
 	msg = spi_transfer(data);		// Send the desired data
 	SS_set_high();
+	reg_shadow_update(CC_EXT, addr, data);
 
 	return;
 }
@@ -543,6 +951,63 @@ void dir_FIFO_write(uint8_t addr, uint8_t data)
 	return;
 }
 
+/************************************************************************/
+/*	DIR_FIFO_WRITE_BURST                                                */
+/*																		*/
+/*	This function writes length bytes from data into the CC1120's FIFO	*/
+/*	starting at addr. The burst bit is set in the header byte so that	*/
+/*	the CC1120 increments the FIFO address after each byte and the		*/
+/*	whole block goes out in one CSn window.								*/
+/*																		*/
+/************************************************************************/
+void dir_FIFO_write_burst(uint8_t addr, uint8_t* data, uint8_t length)
+{
+	uint8_t i;
+	cmd_str(SNOP);
+	
+	SS_set_low();
+	spi_transfer(0b01111110);		// Direct FIFO access, burst, write.
+	spi_transfer(addr);				// Send the starting address
+	for(i = 0; i < length; i++)
+	{
+		spi_transfer(data[i]);
+	}
+	uhf_burst_end();
+	
+	return;
+}
+
+/************************************************************************/
+/*	FIFO_READ_BURST                                                     */
+/*																		*/
+/*	This function reads length bytes out of the CC1120's RX FIFO into	*/
+/*	data within a single CSn window (burst access to STDFIFO).			*/
+/*																		*/
+/************************************************************************/
+void FIFO_read_burst(uint8_t* data, uint8_t length)
+{
+	uint8_t i;
+	
+	SS_set_low();
+	spi_transfer(0b11000000 | STDFIFO);		// Read, burst, standard FIFO.
+	for(i = 0; i < length; i++)
+	{
+		data[i] = spi_transfer(0x00);
+	}
+	uhf_burst_end();
+	
+	return;
+}
+
+// Helper: SS_set_high() is a no-op and the UHF CSn is normally held low (sys_init),
+// but a burst access only ends on a rising edge of CSn.
+static void uhf_burst_end(void)
+{
+	SS1_set_high(COMS_UHF_SS);
+	SS1_set_low(COMS_UHF_SS);
+	return;
+}
+
 /************************************************************************/
 /*		REG_WRITE_BIT                                                   */
 /*																		*/
@@ -552,8 +1017,12 @@ void dir_FIFO_write(uint8_t addr, uint8_t data)
 
 void reg_write_bit(uint8_t reg, uint8_t n, uint8_t data)
 {
-	uint8_t msg, temp;
-	msg = reg_read(reg);
+	uint8_t msg, temp, i;
+	i = reg_shadow_find(0, reg);
+	if(i != 0xFF)
+		msg = uhf_shadow[i];		// No need to ask the chip.
+	else
+		msg = reg_read(reg);
 	if(!data)
 	{
 		temp = ~(1 << n);
@@ -570,8 +1039,12 @@ void reg_write_bit(uint8_t reg, uint8_t n, uint8_t data)
 
 void reg_write_bit2F(uint8_t reg, uint8_t n, uint8_t data)
 {
-	uint8_t msg, temp;
-	msg = reg_read2F(reg);
+	uint8_t msg, temp, i;
+	i = reg_shadow_find(CC_EXT, reg);
+	if(i != 0xFF)
+		msg = uhf_shadow[i];
+	else
+		msg = reg_read2F(reg);
 	if(!data)
 	{
 		temp = ~(1 << n);
@@ -590,18 +1063,16 @@ void reg_write_bit2F(uint8_t reg, uint8_t n, uint8_t data)
 // that you want to communicate with.
 void transceiver_send(uint8_t* message, uint8_t address, uint8_t length)
 {
-	uint8_t i;
+	uint8_t header[2];
 	cmd_str(SIDLE);
 	cmd_str(SFTX);
 	// The first byte is the length of the packet (message + 1 for the address)
-	dir_FIFO_write(0, length+2);
+	header[0] = length + 2;
 	// The second byte is the address
-	dir_FIFO_write(1, address);
+	header[1] = address;
+	dir_FIFO_write_burst(0, header, 2);
 	// The rest is the actual data
-	for(i = 0; i < length; i++)
-	{
-		dir_FIFO_write(i+2, message[i]);
-	}
+	dir_FIFO_write_burst(2, message, length);
 	//set up TX FIFO pointers
 	reg_write2F(TXFIRST, 0x00);            //set TX FIRST to 0
 	reg_write2F(TXLAST, length+3);				//set TX LAST (maximum OF 0X7F)
@@ -611,53 +1082,41 @@ void transceiver_send(uint8_t* message, uint8_t address, uint8_t length)
 	cmd_str(STX);
 	tx_mode = 1;
 	rx_mode = 0;
+	trans_state = TRANS_TX;
+	trans_timer = millis();
 	lastTransmit = millis();
 }
 
 void prepareAck(void)
 {
-	char* ackMessage = "ACK";
-	uint8_t ackAddress = 0xA5, i;
-	cmd_str(SIDLE);
-	cmd_str(SFTX);
-	
-	// Reset FIFO registers
-	reg_write2F(TXFIRST, 0x00);
-	// Put the ACK Packet in the FIFO
-	dir_FIFO_write(0, (3 + 2));
-	dir_FIFO_write(1, ackAddress);
-	
-	for(i = 0; i < 3; i++)
-		dir_FIFO_write(i+2, ackMessage[i]);
-	
-	reg_write2F(TXFIRST, 0);
-	reg_write2F(TXLAST, (3 + 3));
-	reg_write2F(RXFIRST, 0x00);
-	reg_write2F(RXLAST, 0x00);
-	tx_mode = 1;
-	rx_mode = 0;
-	lastTransmit = millis();
+	prepare_reply("ACK");
 	return;
 }
 
 void prepareAnt(void)
 {
-	char* ackMessage = "ANT";
-	uint8_t ackAddress = 0xA5, i;
+	prepare_reply("ANT");
+	return;
+}
+
+// Loads a 3-character reply (ACK_LENGTH) into the TX FIFO.
+static void prepare_reply(char* text)
+{
+	uint8_t packet[ACK_LENGTH + 2];
 	cmd_str(SIDLE);
 	cmd_str(SFTX);
 	
 	// Reset FIFO registers
 	reg_write2F(TXFIRST, 0x00);
-	// Put the ACK Packet in the FIFO
-	dir_FIFO_write(0, (3 + 2));
-	dir_FIFO_write(1, ackAddress);
-	
-	for(i = 0; i < 3; i++)
-	dir_FIFO_write(i+2, ackMessage[i]);
+	// Put the reply packet in the FIFO
+	packet[0] = ACK_LENGTH + 2;
+	packet[1] = 0xA5;
+	for(uint8_t i = 0; i < ACK_LENGTH; i++)
+		packet[i + 2] = (uint8_t)text[i];
+	dir_FIFO_write_burst(0, packet, ACK_LENGTH + 2);
 	
 	reg_write2F(TXFIRST, 0);
-	reg_write2F(TXLAST, (3 + 3));
+	reg_write2F(TXLAST, (ACK_LENGTH + 3));
 	reg_write2F(RXFIRST, 0x00);
 	reg_write2F(RXLAST, 0x00);
 	tx_mode = 1;
@@ -673,126 +1132,100 @@ void clear_new_packet(void)
 	}
 }
 
+/************************************************************************/
+/*	STORE_NEW_PACKET                                                    */
+/*																		*/
+/*	Puts the fragment in new_packet[] into the free slot at the tail of	*/
+/*	the circular queue packet_list[] (frag.c). The TC only joins the	*/
+/*	queue once all of its fragments are in. When the queue is full,		*/
+/*	TC_QUEUE_POLICY decides whether the new TC is refused or the oldest	*/
+/*	one is dropped. The oldest TC is never dropped while it is being	*/
+/*	delivered to the OBC, nor for a fragment which frag_check() does	*/
+/*	not accept.															*/
+/*	Returns 0x00 if the fragment was stored (or already had been), 0xFF	*/
+/*	otherwise.															*/
+/*																		*/
+/************************************************************************/
 uint8_t store_new_packet(void)
 {
-	uint8_t i;	// packet_height = 0, offset = 0;
-	uint16_t pec;
-	//uint32_t rsc;
-	if(packet_count == 5)		
-		return 0xFF;		// Packet_list is currently full, cannot accept new packets.
+	uint8_t* frame = new_packet + 2;
+	uint8_t* slot;
+	uint8_t ret;
 
-	/* There is room in the packet list */
-	if(new_packet[77] != 0x18)					// Characteristic of B151 in a telecommand.
-		return 0xFF;
-		
-	if(new_packet[70] == 69 && new_packet[69] == 13)
+	if(((frame[1] >> 4) == (FRAG_COUNT - 1)) && (frame[FRAG_FRAME_LENGTH - 1] != 0x18))
+		return 0xFF;							// Characteristic of B151 in a telecommand.
+
+	if(packet_count == TC_QUEUE_DEPTH)
 	{
-		alert_deployf = 25;
-		alert_deploy();
+		ret = frag_check(frame);
+		if(ret == FRAG_INVALID)
+			return 0xFF;
+		if(ret == FRAG_DUPLICATE)
+			return 0x00;						// Resent fragment of the TC which filled the queue.
+		tc_overflows++;
+		if((TC_QUEUE_POLICY == TC_DROP_NEWEST) || tc_head_busy)
+		{
+			tc_dropped_newest++;
+			return 0xFF;		// Packet_list is currently full, cannot accept new packets.
+		}
+		tc_dropped_oldest++;
+		tc_head = (tc_head + 1) % TC_QUEUE_DEPTH;
+		packet_count--;
 	}
 
+	slot = packet_list[(tc_head + packet_count) % TC_QUEUE_DEPTH].data;
+	ret = frag_receive(frame, slot);
+	if(ret == FRAG_INVALID)
+		return 0xFF;
+	if(ret != FRAG_COMPLETE)
+		return 0x00;
 	packet_count++;
-	//uart_printf("START PACKET\n\r");
-	for (i = 0; i < 76; i++)
-	{
-		//uart_printf("%u: ", i);
-		//uart_printf("%u\n\r", new_packet[i + 2]);
-		packet_list[packet_count - 1].data[i + 76] = new_packet[i + 2];
-	}
-	//uart_printf("END PACKET\n\r");
-	for(i = 0; i < 76; i++)
+
+	if(slot[144] == 69 && slot[143] == 13)
 	{
-		packet_list[packet_count - 1].data[i] = 0;
+		alert_deployf = 25;
+		alert_deploy();
 	}
-	pec = fletcher16(packet_list[packet_count - 1].data + 2, 150);
-	packet_list[packet_count - 1].data[1] = (uint8_t)(pec >> 8);
-	packet_list[packet_count - 1].data[0] = (uint8_t)pec;
-
-	//last_rx_packet_height = packet_height;
 	return 0x00;
 }
 
-// The packet to be transmitted is assumed to be tm_to_downlink[] and be 152 bytes long.
-uint8_t transmit_packet(void)
-{
-	//if(!current_tm_fullf)
-		//return 0xFF;
-	
-	// Adjust the sequence control variables if an acknowledgment was received.
-	//if(ack_acquired)
-	//{
-		//if(!last_tx_packet_height)
-			//last_tx_packet_height = 1;
-		//else
-			//last_tx_packet_height = 0;
-		////transmitting_sequence_control++;
-		//ack_acquired = 0;
-	//}
-	
-	// Place the sequence control variables in the packet to be sent.
-	//t_message[79] = last_tx_packet_height;
-	//t_message[78] = (uint8_t)(transmitting_sequence_control >> 16);
-	//t_message[77] = (uint8_t)(transmitting_sequence_control >> 8);
-	//t_message[76] = (uint8_t)transmitting_sequence_control;
-	//send_can_value(t_message + 74);
-	
-	//if(last_tx_packet_height)
-		//offset = 76;
-	tm_to_downlink[151] = 0x18;		// Required in order to quickly authenticate the packet.
-	transceiver_send(tm_to_downlink + 76, DEVICE_ADDRESS, 76);
-	return 1;
-}
-
+/************************************************************************/
+/*	LOAD_PACKET_TO_CURRENT_TC                                           */
+/*																		*/
+/*	Points current_tc at the oldest TC in the queue. The TC stays in	*/
+/*	its slot until release_current_tc() is called once it has been		*/
+/*	delivered (or given up on).											*/
+/*																		*/
+/************************************************************************/
 void load_packet_to_current_tc(void)
 {
-	uint8_t i, j;
 	if(!packet_count)
-	{
-		clear_current_tc();
 		return;
-	}
-	for(i = 0; i < PACKET_LENGTH; i++)
-	{
-		current_tc[i] = packet_list[0].data[i];
-	}
-	for(j = 0; j < (packet_count - 1); j++)			// Shift the packet list down.
-	{
-		for(i = 0; i < PACKET_LENGTH; i++)
-		{
-			packet_list[j].data[i] = packet_list[j + 1].data[i];
-		}
-	}
-	packet_count--;
+	current_tc = packet_list[tc_head].data;
+	tc_head_busy = 1;
 	return;
 }
 
-static void clear_current_tc(void)
+void release_current_tc(void)
 {
-	uint8_t i;
-	for(i = 0; i < PACKET_LENGTH; i++)
+	if(tc_head_busy && packet_count)
 	{
-		current_tc[i] = 0;
+		tc_head = (tc_head + 1) % TC_QUEUE_DEPTH;
+		packet_count--;
 	}
+	tc_head_busy = 0;
 	return;
 }
 
 void load_packet(void)
 {
-	uint8_t i;
-	for(i = 0; i < (REAL_PACKET_LENGTH + 2); i++)
-	{
-		new_packet[i] = reg_read(STDFIFO);
-	}
+	FIFO_read_burst(new_packet, REAL_PACKET_LENGTH + 2 + UHF_STATUS_LENGTH);
 	return;
 }
 
 void load_ack(void)
 {
-	uint8_t i;
-	for(i = 0; i < (ACK_LENGTH + 2); i++)
-	{
-		new_packet[i] = reg_read(STDFIFO);
-	}
+	FIFO_read_burst(new_packet, ACK_LENGTH + 2 + UHF_STATUS_LENGTH);
 	return;
 }
 
@@ -806,49 +1239,29 @@ void setup_fake_tc(void)
 	service_type = 3;			// HK Service
 	service_sub_type = 9;		// Req HK Definition report
 	// Packet Header
-	tm_to_downlink[151] = ((version & 0x07) << 5) | ((type & 0x01) << 4) | (0x08);
-	tm_to_downlink[150] = HK_TASK_ID;
-	tm_to_downlink[149] = sequence_flags;
-	tm_to_downlink[148] = transmitting_sequence_control;
-	tm_to_downlink[147] = 0x00;
-	tm_to_downlink[146] = PACKET_LENGTH - 1;
+	current_tm[151] = ((version & 0x07) << 5) | ((type & 0x01) << 4) | (0x08);
+	current_tm[150] = HK_TASK_ID;
+	current_tm[149] = sequence_flags;
+	current_tm[148] = transmitting_sequence_control;
+	current_tm[147] = 0x00;
+	current_tm[146] = PACKET_LENGTH - 1;
 	version = 1;
 	// Data Field Header
-	tm_to_downlink[145] = ((version & 0x07) << 4) | 0x8A;
-	tm_to_downlink[144] = service_type;
-	tm_to_downlink[143] = service_sub_type;
-	tm_to_downlink[142] = HK_GROUND_ID;
-	tm_to_downlink[140] = 0;
-	tm_to_downlink[139] = 0;
-	pec = fletcher16(tm_to_downlink + 2, 150);
-	tm_to_downlink[1] = (uint8_t)(pec >> 8);
-	tm_to_downlink[0] = (uint8_t)(pec);
+	current_tm[145] = ((version & 0x07) << 4) | 0x8A;
+	current_tm[144] = service_type;
+	current_tm[143] = service_sub_type;
+	current_tm[142] = HK_GROUND_ID;
+	current_tm[140] = 0;
+	current_tm[139] = 0;
+	pec = fletcher16(current_tm + 2, 150);
+	current_tm[1] = (uint8_t)(pec >> 8);
+	current_tm[0] = (uint8_t)(pec);
 	
-	tm_to_downlink[75] = 0x88;		// Indicator of this being the lower 76 bytes.
+	current_tm[75] = 0x88;		// Indicator of this being the lower 76 bytes.
 	
+	current_tm_fullf = 1;
+	store_current_tm();
 	return;
 }
 
-/************************************************************************/
-/* FLETCHER16				                                            */
-/* @Purpose: This function runs Fletcher's checksum algorithm on spimem	*/
-/* @param: *data: pointer to the point in memory that you would to start*/
-/* hashing.																*/
-/* @param: count: how many BYTES in memory, you would like to hash		*/
-/* @return: the 16-bit checksum value.									*/
-/************************************************************************/
-uint16_t fletcher16(uint8_t* data, int count)
-{
-	uint16_t sum1 = 0;
-	uint16_t sum2 = 0;
-	int i;
-	
-	for(i = 0; i < count; i++)
-	{
-		sum1 = (sum1 + data[i]) % 255;
-		sum2 = (sum2 + sum1) % 255;
-	}
-	return (sum2 << 8) | sum1;
-}
-
 #endif
\ No newline at end of file
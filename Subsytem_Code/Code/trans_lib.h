@@ -30,6 +30,10 @@
 	*					I also added a macro which obtains the current count of milliseconds
 	*					which have gone by.
 	*
+	*	10/17/2026		Added the transceiver_run() states and the GPIO0 interrupt pin.
+	*
+	*					Added the cc1120_reg flags and reg_burst_all() modes.
+	*
 */
 #ifndef TRANS_LIB_H
 #define TRANS_LIB_H
@@ -40,6 +44,9 @@
 #include "global_var.h"
 #include "can_api.h"
 #include "commands.h"
+#include "checksum.h"
+#include "dl_arq.h"
+#include "frag.h"
 #include <stdlib.h>
 #include "uart.h"
 
@@ -51,11 +58,50 @@
 #define ACK_TIMEOUT 1000
 #define TRANSCEIVER_CYCLE 250
 #define TRANSMIT_TIMEOUT 2000
-#define CALIBRATION_TIMEOUT 5000
+#define CALIBRATION_TIMEOUT 5000	// How often uhf_cal_check() runs.
 #define DEVICE_ADDRESS 0xA5
-#define REAL_PACKET_LENGTH 76
+#define REAL_PACKET_LENGTH FRAG_FRAME_LENGTH	// Payload of an uplinked frame.
 #define ACK_LENGTH 3
+#define UHF_STATUS_LENGTH 2		// RSSI, CRC_OK | LQI appended to every packet received (PKT_CFG1).
 #define TM_TIMEOUT 5000
+#define TRANS_TX_TIMEOUT 160		// ms, a full 81B packet takes ~80 ms on air.
+
+/* Downlink window (dl_arq.c) */
+#define DL_ACK_TAG			0x53	// 'S', first byte of a selective acknowledgment.
+#define DL_RTO_MIN			256		// ms, floor for the retransmission timeout.
+#define DL_GAP_MIN			96		// ms, floor for the time between two frames.
+
+/* transceiver_run() states */
+#define TRANS_LISTEN		0		// In RX, waiting for the end of a packet.
+#define TRANS_TURNAROUND	1		// Packet read, the CC1120 may be auto-transmitting (RFEND_CFG1).
+#define TRANS_TX			2		// Waiting for our own packet to go out.
+
+/* Reasons to calibrate (uhf_cal_pending) */
+#define CAL_TEMP			0x01	// COMS temperature moved by CAL_TEMP_DELTA.
+#define CAL_FREQOFF			0x02	// Average FREQOFF_EST moved by CAL_FREQOFF_DELTA.
+#define CAL_RXERR			0x04	// RX or TX FIFO error state.
+#define CAL_TXFAIL			0x08	// A packet was still in the TX FIFO after its retry.
+#define CAL_UPSET			0x10	// A register differs from uhf_shadow[].
+#define CAL_AGE				0x20	// CAL_MAX_INTERVAL since the last calibration.
+#define CAL_TEMP_DELTA		4		// deg C
+#define CAL_FREQOFF_DELTA	16		// FREQOFF_EST counts, ~2 kHz.
+#define CAL_MIN_INTERVAL	30000	// ms, the most often drift alone may cause a calibration.
+#define CAL_MAX_INTERVAL	600000	// ms
+#define CAL_QUIET			TRANSCEIVER_CYCLE	// ms since the last packet received.
+
+/* cc1120_reg flags */
+#define CC_EXT				0x01	// Extended register space (0x2F prefix).
+#define CC_NO_VERIFY		0x02	// Changed by the CC1120 itself (e.g. SAFC), not scrubbed.
+
+/* reg_burst_all() modes */
+#define CC_BURST_WRITE		0		// Write uhf_shadow[] to the chip.
+#define CC_BURST_READ		1		// Compare the chip with uhf_shadow[].
+#define CC_BURST_REPAIR		2		// CC_BURST_WRITE without the CC_NO_VERIFY registers.
+
+/* CC1120 GPIO0 (PKT_SYNC_RXTX) is assumed to be wired to PD7 / PCINT23. Not confirmed against the
+   COMS schematic, only the end-of-packet interrupt uses the pin (see uhf_rx_active()). */
+#define UHF_GPIO_BIT		7
+#define UHF_GPIO_HIGH()		(PIND & (1 << UHF_GPIO_BIT))
 
 //define crystal oscillator frequency to 32MHz
 #define f_xosc 32000000;							// What is this used for?
@@ -287,20 +333,23 @@ void get_status(uint8_t *CHIP_RDYn, uint8_t *state);
 uint8_t cmd_str(uint8_t addr);
 uint8_t dir_FIFO_read(uint8_t addr);
 void dir_FIFO_write(uint8_t addr, uint8_t data);
+void dir_FIFO_write_burst(uint8_t addr, uint8_t* data, uint8_t length);
+void FIFO_read_burst(uint8_t* data, uint8_t length);
 void reg_write_bit(uint8_t reg, uint8_t n, uint8_t data);
 void reg_write_bit2F(uint8_t reg, uint8_t n, uint8_t data);
 void transceiver_send(uint8_t* message, uint8_t address, uint8_t length);
 void reg_settings(void);
+uint8_t reg_scrub(void);
 void prepareAck(void);
 void transceiver_run(void);
 void clear_new_packet(void);
 uint8_t store_new_packet(void);
 void load_packet_to_current_tc(void);
+void release_current_tc(void);
 void load_packet(void);
 void load_ack(void);
-uint8_t transmit_packet(void);
 void setup_fake_tc(void);
-uint16_t fletcher16(uint8_t* data, int count);
 void prepareAnt(void);
+void rf_link_reset(void);
 
 #endif